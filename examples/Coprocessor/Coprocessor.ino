@@ -0,0 +1,92 @@
+/*
+ * Example turning a board into an I2C encoder co-processor. Four
+ * encoders with buttons are polled locally, and a main controller reads
+ * them all with one burst from the register map in rotary_coprocessor.h.
+ *
+ * The main controller sets the register pointer by writing one byte, then
+ * reads. Wire does not tell this side how many bytes the master clocks
+ * out, so each read returns at most the header registers or one encoder
+ * block, and only that block counts as read. For example, to read the
+ * block of encoder n:
+ *
+ *   Wire.beginTransmission(0x36);
+ *   Wire.write(ROTARY_REG_ENCODERS + n * ROTARY_COPRO_STRIDE);
+ *   Wire.endTransmission(false);
+ *   Wire.requestFrom(0x36, ROTARY_COPRO_STRIDE);
+ *
+ * Pin 13 goes low while an encoder has changed since it was last read, so
+ * the main controller only needs to read when it is low, and then only
+ * the blocks flagged in the status register.
+ */
+
+#include <Wire.h>
+#include <rotary.h>
+#include <rotary_group.h>
+#include <rotary_coprocessor.h>
+
+#define ADDRESS 0x36
+#define INT_PIN 13
+
+Rotary rotaries[4] = {
+  Rotary(2, 3, 4), Rotary(5, 6, 7), Rotary(8, 9, 10), Rotary(11, 12, A0)
+};
+
+RotaryGroup group;
+RotaryCoprocessor coprocessor(group);
+
+// Register the master's next read starts at.
+unsigned char address = 0;
+
+// The master wrote: the first byte sets the register pointer, the rest
+// are written to the registers. A write of the pointer alone leaves the
+// transaction open for the read that follows; a write of registers ends
+// it, as no read is coming.
+void receive(int count) {
+  coprocessor.end();
+  if (count > 0) {
+    address = Wire.read();
+    coprocessor.begin(address);
+    while (Wire.available()) {
+      coprocessor.write(Wire.read());
+      address++;
+    }
+    if (count > 1) {
+      coprocessor.end();
+    }
+  }
+}
+
+// The master reads: queue the bytes from the pointer to the end of the
+// header registers or of the encoder block it is in. Wire has no callback
+// for the stop condition, so the transaction ends here, and only the one
+// block queued counts as read.
+void request() {
+  unsigned char count;
+  if (address < ROTARY_REG_ENCODERS) {
+    count = ROTARY_REG_ENCODERS - address;
+  }
+  else {
+    count = ROTARY_COPRO_STRIDE - (address - ROTARY_REG_ENCODERS) % ROTARY_COPRO_STRIDE;
+  }
+  // Starts a transaction if the master did not set the pointer first
+  coprocessor.begin(address);
+  for (unsigned char i = 0; i < count; i++) {
+    Wire.write(coprocessor.read());
+  }
+  coprocessor.end();
+}
+
+void setup() {
+  for (unsigned char i = 0; i < 4; i++) {
+    group.addWithButton(rotaries[i]);
+  }
+  coprocessor.setInterruptPin(INT_PIN);
+  Wire.begin(ADDRESS);
+  Wire.onReceive(receive);
+  Wire.onRequest(request);
+}
+
+void loop() {
+  group.processAll(200);
+  coprocessor.service();
+}
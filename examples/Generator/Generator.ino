@@ -0,0 +1,56 @@
+/*
+ * Example turning an Uno into a quadrature signal source for testing
+ * another board's decoding. Timer 1 calls the generator 10000 times a
+ * second; the sketch runs out a revolution and back at increasing
+ * speeds, with some contact bounce, and clicks the button between runs.
+ *
+ * Wire pins 8 and 9 to the encoder inputs of the board under test, pin 10
+ * to its button input and pin 11 to its index input, and join the
+ * grounds.
+ */
+
+#include <rotary_generator.h>
+
+#define TICK_RATE 10000
+// Quarter-steps per revolution, ie. 24 detents in full-step mode.
+#define REVOLUTION 96
+
+RotaryGenerator generator = RotaryGenerator(8, 9);
+
+ISR(TIMER1_COMPA_vect) {
+  generator.tick();
+}
+
+void setup() {
+  Serial.begin(57600);
+  generator.setButton(10);
+  generator.setIndex(11, REVOLUTION);
+  generator.begin(TICK_RATE);
+  // Bounce for up to 2 ticks (200 us) after each edge
+  generator.setBounce(2, 64);
+
+  // Timer 1 in CTC mode, no prescaler, interrupting at TICK_RATE
+  noInterrupts();
+  TCCR1A = 0;
+  TCCR1B = _BV(WGM12) | _BV(CS10);
+  OCR1A = F_CPU / TICK_RATE - 1;
+  TIMSK1 = _BV(OCIE1A);
+  interrupts();
+}
+
+void loop() {
+  for (long speed = 250; speed <= TICK_RATE / 4; speed *= 2) {
+    Serial.print("Speed ");
+    Serial.println(speed);
+    generator.moveTo(REVOLUTION, speed);
+    while (generator.moving()) {
+    }
+    generator.moveTo(0, speed);
+    while (generator.moving()) {
+    }
+    generator.press(true);
+    delay(100);
+    generator.press(false);
+    delay(400);
+  }
+}
@@ -0,0 +1,34 @@
+/*
+ * Example using the Rotary library with interrupts, dumping the position
+ * to the serial port whenever it changes.
+ *
+ * rotaryInterrupt<rotary> is an interrupt handler generated for this
+ * encoder, so the sketch does not need to write one. If a faulty encoder
+ * fires more than 1000 interrupts within 10ms, the library detaches them
+ * and poll() decodes it until it settles down.
+ */
+
+#include <rotary.h>
+
+// Rotary encoder is wired with the common to ground and the two
+// outputs to pins 2 and 3, which both have external interrupts on an Uno.
+Rotary rotary = Rotary(2, 3);
+
+long lastPosition = 0;
+
+void setup() {
+  Serial.begin(57600);
+  rotary.setStormLimit(1000, 10);
+  rotary.attachInterrupts(rotaryInterrupt<rotary>);
+}
+
+void loop() {
+  // Only does anything while a storm has the encoder on polling.
+  rotary.poll();
+
+  long position = rotary.readPosition();
+  if (position != lastPosition) {
+    lastPosition = position;
+    Serial.println(position);
+  }
+}
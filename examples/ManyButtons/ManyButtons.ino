@@ -0,0 +1,104 @@
+/*
+ * Example keeping the debounce, long-press and double-click deadlines of
+ * many buttons on one RotaryTimerWheel, printing the gestures to the
+ * serial port.
+ *
+ * loop() only compares each pin with its last level. Everything that
+ * waits for time to pass is a timer on the wheel, so a button with no
+ * deadline pending costs nothing on a tick.
+ */
+
+#include <rotary_timer.h>
+
+#define BUTTONS 8
+#define DEBOUNCE 20
+#define LONG_PRESS 600
+#define DOUBLE_CLICK 300
+
+// Buttons are wired from these pins to ground.
+const unsigned char pins[BUTTONS] = {2, 3, 4, 5, 6, 7, 8, 9};
+
+struct Button {
+  unsigned char index;
+  bool level;
+  bool pressed;
+  bool held;
+  unsigned char clicks;
+  RotaryTimer debounce;
+  RotaryTimer gesture;
+};
+
+Button buttons[BUTTONS];
+RotaryTimerWheel wheel;
+
+void report(Button &button, const char *gesture) {
+  Serial.print("Button ");
+  Serial.print(button.index);
+  Serial.print(": ");
+  Serial.println(gesture);
+}
+
+// The pin has been quiet for DEBOUNCE ms: take its level.
+void debounced(void *context) {
+  Button &button = *(Button *)context;
+  bool pressed = !digitalRead(pins[button.index]);
+  if (pressed == button.pressed) {
+    return;
+  }
+  button.pressed = pressed;
+  if (pressed) {
+    button.held = false;
+    wheel.schedule(button.gesture, LONG_PRESS);
+  }
+  else if (!button.held) {
+    if (++button.clicks == 2) {
+      wheel.cancel(button.gesture);
+      button.clicks = 0;
+      report(button, "double click");
+    }
+    else {
+      wheel.schedule(button.gesture, DOUBLE_CLICK);
+    }
+  }
+}
+
+// Either still pressed after LONG_PRESS ms, or no second click came
+// within DOUBLE_CLICK ms of the first.
+void gesture(void *context) {
+  Button &button = *(Button *)context;
+  if (button.clicks) {
+    report(button, "click");
+    button.clicks = 0;
+  }
+  if (button.pressed) {
+    button.held = true;
+    report(button, "long press");
+  }
+}
+
+void setup() {
+  Serial.begin(57600);
+  wheel.begin(millis());
+  for (unsigned char i = 0; i < BUTTONS; i++) {
+    pinMode(pins[i], INPUT_PULLUP);
+    buttons[i].index = i;
+    buttons[i].level = digitalRead(pins[i]);
+    buttons[i].pressed = false;
+    buttons[i].held = false;
+    buttons[i].clicks = 0;
+    buttons[i].debounce.set(debounced, &buttons[i]);
+    buttons[i].gesture.set(gesture, &buttons[i]);
+  }
+}
+
+void loop() {
+  for (unsigned char i = 0; i < BUTTONS; i++) {
+    bool level = digitalRead(pins[i]);
+    if (level != buttons[i].level) {
+      // Every bounce pushes the debounce deadline back
+      buttons[i].level = level;
+      wheel.schedule(buttons[i].debounce, DEBOUNCE);
+    }
+  }
+  wheel.advance(millis());
+}
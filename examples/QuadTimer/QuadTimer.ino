@@ -0,0 +1,37 @@
+/*
+ * Example counting an encoder with an STM32 timer in encoder mode, dumping
+ * the position and speed to the serial port whenever the position
+ * changes. The timer decodes the pins by itself, so no interrupts are
+ * taken while the encoder turns.
+ *
+ * For the STM32 core for Arduino. The encoder is wired with the common to
+ * ground and the two outputs to PA0 and PA1, channels 1 and 2 of TIM2.
+ */
+
+#include <rotary_quad_timer.h>
+
+RotaryQuadTimer encoder = RotaryQuadTimer((RotaryQuadTimerRegisters *)TIM2);
+
+long lastPosition = 0;
+
+void setup() {
+  Serial.begin(57600);
+  // Clock the timer, and hand the pins to it with their pull-ups on
+  __HAL_RCC_TIM2_CLK_ENABLE();
+  pinmap_pinout(digitalPinToPinName(PA0), PinMap_TIM);
+  pinmap_pinout(digitalPinToPinName(PA1), PinMap_TIM);
+  // Ignore contact chatter shorter than 8 samples at a quarter of the
+  // timer clock
+  encoder.setFilter(7);
+  encoder.begin();
+}
+
+void loop() {
+  long position = encoder.readPosition();
+  if (position != lastPosition) {
+    lastPosition = position;
+    Serial.print(position);
+    Serial.print(" ");
+    Serial.println(encoder.readVelocity());
+  }
+}
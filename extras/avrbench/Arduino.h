@@ -0,0 +1,47 @@
+/*
+ * Minimal Arduino core for the simavr benchmark, ATmega328P (Uno) only.
+ * Pins 0-7 are PORTD and 8-13 are PORTB. digitalRead() and digitalWrite()
+ * use program-memory lookup tables like the real core does, and millis()
+ * counts Timer0 overflows the same way, so the library's calls into the
+ * core cost about what they do on a real board.
+ */
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <stdint.h>
+#include <string.h>
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+#define NOT_AN_INTERRUPT -1
+#define digitalPinToInterrupt(p) ((p) == 2 ? 0 : ((p) == 3 ? 1 : NOT_AN_INTERRUPT))
+
+#define noInterrupts() cli()
+#define interrupts() sei()
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+void init();
+void pinMode(uint8_t, uint8_t);
+void digitalWrite(uint8_t, uint8_t);
+int digitalRead(uint8_t);
+unsigned long millis();
+unsigned long micros();
+void attachInterrupt(uint8_t, void (*)(void), int);
+void detachInterrupt(uint8_t);
+
+#endif
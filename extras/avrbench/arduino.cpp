@@ -0,0 +1,161 @@
+/*
+ * Minimal Arduino core for the simavr benchmark, see Arduino.h.
+ */
+
+#include "Arduino.h"
+
+static const uint8_t PROGMEM pinBits[] = {
+  _BV(0), _BV(1), _BV(2), _BV(3), _BV(4), _BV(5), _BV(6), _BV(7),
+  _BV(0), _BV(1), _BV(2), _BV(3), _BV(4), _BV(5),
+};
+
+// 0 for PORTD, 1 for PORTB
+static const uint8_t PROGMEM pinPorts[] = {
+  0, 0, 0, 0, 0, 0, 0, 0,
+  1, 1, 1, 1, 1, 1,
+};
+
+#define PIN_COUNT sizeof(pinPorts)
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin >= PIN_COUNT) {
+    return;
+  }
+  uint8_t bit = pgm_read_byte(pinBits + pin);
+  volatile uint8_t *ddr = pgm_read_byte(pinPorts + pin) ? &DDRB : &DDRD;
+  volatile uint8_t *port = pgm_read_byte(pinPorts + pin) ? &PORTB : &PORTD;
+  uint8_t oldSREG = SREG;
+  cli();
+  if (mode == OUTPUT) {
+    *ddr |= bit;
+  }
+  else {
+    *ddr &= ~bit;
+    if (mode == INPUT_PULLUP) {
+      *port |= bit;
+    }
+    else {
+      *port &= ~bit;
+    }
+  }
+  SREG = oldSREG;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  if (pin >= PIN_COUNT) {
+    return;
+  }
+  uint8_t bit = pgm_read_byte(pinBits + pin);
+  volatile uint8_t *port = pgm_read_byte(pinPorts + pin) ? &PORTB : &PORTD;
+  uint8_t oldSREG = SREG;
+  cli();
+  if (val == LOW) {
+    *port &= ~bit;
+  }
+  else {
+    *port |= bit;
+  }
+  SREG = oldSREG;
+}
+
+int digitalRead(uint8_t pin) {
+  if (pin >= PIN_COUNT) {
+    return LOW;
+  }
+  uint8_t bit = pgm_read_byte(pinBits + pin);
+  volatile uint8_t *input = pgm_read_byte(pinPorts + pin) ? &PINB : &PIND;
+  if (*input & bit) {
+    return HIGH;
+  }
+  return LOW;
+}
+
+// Timer0 runs at F_CPU / 64 and overflows every 256 ticks, as in wiring.c
+#define MICROSECONDS_PER_TIMER0_OVERFLOW (64UL * 256 / (F_CPU / 1000000UL))
+#define MILLIS_INC (MICROSECONDS_PER_TIMER0_OVERFLOW / 1000)
+#define FRACT_INC ((MICROSECONDS_PER_TIMER0_OVERFLOW % 1000) >> 3)
+#define FRACT_MAX (1000 >> 3)
+
+static volatile unsigned long timer0Overflows = 0;
+static volatile unsigned long timer0Millis = 0;
+static unsigned char timer0Fract = 0;
+
+ISR(TIMER0_OVF_vect) {
+  unsigned long m = timer0Millis;
+  unsigned char f = timer0Fract;
+  m += MILLIS_INC;
+  f += FRACT_INC;
+  if (f >= FRACT_MAX) {
+    f -= FRACT_MAX;
+    m += 1;
+  }
+  timer0Fract = f;
+  timer0Millis = m;
+  timer0Overflows++;
+}
+
+unsigned long millis() {
+  uint8_t oldSREG = SREG;
+  cli();
+  unsigned long m = timer0Millis;
+  SREG = oldSREG;
+  return m;
+}
+
+unsigned long micros() {
+  uint8_t oldSREG = SREG;
+  cli();
+  unsigned long m = timer0Overflows;
+  uint8_t t = TCNT0;
+  if ((TIFR0 & _BV(TOV0)) && (t < 255)) {
+    m++;
+  }
+  SREG = oldSREG;
+  return ((m << 8) + t) * (64 / (F_CPU / 1000000UL));
+}
+
+static void (*interruptHandlers[2])(void);
+
+void attachInterrupt(uint8_t interrupt, void (*handler)(void), int mode) {
+  if (interrupt > 1) {
+    return;
+  }
+  interruptHandlers[interrupt] = handler;
+  // The mode values match the ISCn1:ISCn0 encodings for CHANGE, FALLING and RISING
+  if (interrupt == 0) {
+    EICRA = (EICRA & ~(_BV(ISC00) | _BV(ISC01))) | (mode << ISC00);
+    EIMSK |= _BV(INT0);
+  }
+  else {
+    EICRA = (EICRA & ~(_BV(ISC10) | _BV(ISC11))) | (mode << ISC10);
+    EIMSK |= _BV(INT1);
+  }
+}
+
+void detachInterrupt(uint8_t interrupt) {
+  if (interrupt == 0) {
+    EIMSK &= ~_BV(INT0);
+  }
+  else if (interrupt == 1) {
+    EIMSK &= ~_BV(INT1);
+  }
+  if (interrupt <= 1) {
+    interruptHandlers[interrupt] = 0;
+  }
+}
+
+ISR(INT0_vect) {
+  interruptHandlers[0]();
+}
+
+ISR(INT1_vect) {
+  interruptHandlers[1]();
+}
+
+void init() {
+  // Timer0 in normal mode, prescaler 64, overflow interrupt for millis()
+  TCCR0A = 0;
+  TCCR0B = _BV(CS01) | _BV(CS00);
+  TIMSK0 = _BV(TOIE0);
+  sei();
+}
@@ -0,0 +1,82 @@
+/*
+ * Benchmark firmware for the simavr runner, see Makefile.
+ *
+ * Each benchmark calls one library method BENCH_ROUNDS times. Before each
+ * call the firmware writes the benchmark id to GPIOR0 and pulses pin 12
+ * (PB4), which asks the runner for the next pin stimulus. The call itself
+ * is bracketed by pin 13 (PB5) going high and low, and the runner counts
+ * the cycles in between. The interrupt benchmarks let the stimulus fire
+ * the encoder's interrupt instead, and the runner times the handler.
+ */
+
+#include "Arduino.h"
+#include <avr/sleep.h>
+#include "rotary.h"
+#include "bench.h"
+
+// Encoder on pins 2 and 3 (INT0 and INT1), button on pin 4
+Rotary rotary = Rotary(2, 3, 4);
+
+volatile long sink;
+
+static inline void request(unsigned char id) {
+  GPIOR0 = id;
+  PORTB |= _BV(PB4);
+  PORTB &= ~_BV(PB4);
+}
+
+#define MEASURE(id, call)                         \
+  for (unsigned char i = 0; i < BENCH_ROUNDS; i++) { \
+    request(id);                                  \
+    PORTB |= _BV(PB5);                            \
+    call;                                         \
+    PORTB &= ~_BV(PB5);                           \
+  }
+
+// Waits long enough for a pending interrupt to be taken and finish.
+static void settle() {
+  for (volatile unsigned char d = 0; d < 100; d++) {
+  }
+}
+
+// Clockwise Gray sequence as (pin2 << 1) | pin1
+static const unsigned char cw[4] = {2, 3, 1, 0};
+
+int main() {
+  init();
+  DDRB |= _BV(PB4) | _BV(PB5);
+  // Tell the runner how much RAM each encoder takes
+  GPIOR1 = sizeof(Rotary);
+
+  MEASURE(BENCH_EMPTY, );
+  MEASURE(BENCH_PROCESS, sink = rotary.process());
+  MEASURE(BENCH_PROCESS_PINS, sink = rotary.process(cw[i & 3]));
+  MEASURE(BENCH_POLL, sink = rotary.poll());
+  MEASURE(BENCH_CHANNEL_A, sink = rotary.processChannelA());
+  MEASURE(BENCH_READ_POSITION, sink = rotary.readPosition());
+  MEASURE(BENCH_PRESSED_RELEASED, sink = rotary.buttonPressedReleased(20));
+  MEASURE(BENCH_PRESSED_HELD, sink = rotary.buttonPressedHeld(500));
+  MEASURE(BENCH_READ_BUTTON, sink = rotary.readButton());
+  MEASURE(BENCH_PRESSED_LEADING, sink = rotary.buttonPressedLeading(20));
+
+  rotary.attachInterrupts(rotaryInterrupt<rotary>);
+  for (unsigned char i = 0; i < BENCH_ROUNDS; i++) {
+    request(BENCH_ISR);
+    settle();
+  }
+  rotary.detachInterrupts();
+
+  rotary.attachInterruptA(rotaryInterruptA<rotary>);
+  for (unsigned char i = 0; i < BENCH_ROUNDS; i++) {
+    request(BENCH_ISR_A);
+    settle();
+  }
+  rotary.detachInterrupts();
+
+  // Sleeping with interrupts off ends the simulation
+  GPIOR0 = BENCH_DONE;
+  cli();
+  sleep_enable();
+  sleep_cpu();
+  return 0;
+}
@@ -0,0 +1,27 @@
+/*
+ * Benchmark ids shared by the firmware (bench.cpp) and the simavr runner
+ * (runner.c). The firmware writes the id to GPIOR0 before each call.
+ */
+
+#ifndef bench_h
+#define bench_h
+
+#define BENCH_ROUNDS 64
+
+#define BENCH_EMPTY 0
+#define BENCH_PROCESS 1
+#define BENCH_PROCESS_PINS 2
+#define BENCH_POLL 3
+#define BENCH_CHANNEL_A 4
+#define BENCH_READ_POSITION 5
+#define BENCH_PRESSED_RELEASED 6
+#define BENCH_PRESSED_HELD 7
+#define BENCH_READ_BUTTON 8
+#define BENCH_PRESSED_LEADING 9
+#define BENCH_ISR 10
+#define BENCH_ISR_A 11
+#define BENCH_COUNT 12
+
+#define BENCH_DONE 0xff
+
+#endif
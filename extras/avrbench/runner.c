@@ -0,0 +1,201 @@
+/*
+ * Runs the benchmark firmware under simavr and reports cycle counts.
+ *
+ *   ./runner bench.elf
+ *
+ * The runner drives the encoder pins (PD2, PD3) and the button pin (PD4)
+ * from a script, advancing it each time the firmware pulses PB4. It
+ * counts the cycles PB5 stays high around each call, less the cost of
+ * toggling PB5 itself (the empty benchmark). For the interrupt
+ * benchmarks it counts from the pin change to the interrupt vector
+ * (latency) and from the vector to the return from interrupt (entry to
+ * exit, including the core's dispatch through attachInterrupt()).
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "avr_ioport.h"
+
+#include "bench.h"
+
+// ATmega328P data-space addresses and vector byte addresses
+#define GPIOR0_ADDR 0x3e
+#define GPIOR1_ADDR 0x4a
+#define INT0_VECTOR 0x0004
+#define INT1_VECTOR 0x0008
+
+static const char *names[BENCH_COUNT] = {
+  "empty",
+  "process()",
+  "process(pinstate)",
+  "poll()",
+  "processChannelA()",
+  "readPosition()",
+  "buttonPressedReleased(20)",
+  "buttonPressedHeld(500)",
+  "readButton()",
+  "buttonPressedLeading(20)",
+  "rotaryInterrupt<> (ISR)",
+  "rotaryInterruptA<> (ISR)",
+};
+
+// Clockwise Gray sequence as (pin2 << 1) | pin1
+static const unsigned char cw[4] = {2, 3, 1, 0};
+
+static avr_t *avr;
+static avr_irq_t *pinA;
+static avr_irq_t *pinB;
+static avr_irq_t *pinButton;
+
+static unsigned long samples[BENCH_COUNT][BENCH_ROUNDS];
+static unsigned int counts[BENCH_COUNT];
+static unsigned long latency[BENCH_COUNT][BENCH_ROUNDS];
+
+static uint64_t markStart;
+static unsigned char code;
+static unsigned char button = 1;
+static unsigned int requests;
+
+// 0 idle, 1 waiting for the vector, 2 inside the handler
+static int watching;
+static unsigned char watchId;
+static uint64_t raiseCycle;
+static uint64_t entryCycle;
+
+static void record(unsigned char id, unsigned long cycles, unsigned long wait) {
+  if (id < BENCH_COUNT && counts[id] < BENCH_ROUNDS) {
+    latency[id][counts[id]] = wait;
+    samples[id][counts[id]++] = cycles;
+  }
+}
+
+static void markChanged(struct avr_irq_t *irq, uint32_t value, void *param) {
+  (void)irq;
+  (void)param;
+  if (value) {
+    markStart = avr->cycle;
+  }
+  else {
+    record(avr->data[GPIOR0_ADDR], (unsigned long)(avr->cycle - markStart), 0);
+  }
+}
+
+static void requestChanged(struct avr_irq_t *irq, uint32_t value, void *param) {
+  (void)irq;
+  (void)param;
+  if (!value) {
+    return;
+  }
+  unsigned char id = avr->data[GPIOR0_ADDR];
+  if (id >= BENCH_PRESSED_RELEASED && id <= BENCH_PRESSED_LEADING) {
+    // Press and release the button every eight calls
+    if (requests++ % 8 == 0) {
+      button = !button;
+      avr_raise_irq(pinButton, button);
+    }
+    return;
+  }
+  // Turn the encoder one transition clockwise
+  unsigned char last = code;
+  code = cw[(requests++) & 3];
+  avr_raise_irq(pinA, code & 1);
+  avr_raise_irq(pinB, code >> 1);
+  if (id == BENCH_ISR || (id == BENCH_ISR_A && ((code ^ last) & 1))) {
+    watching = 1;
+    watchId = id;
+    raiseCycle = avr->cycle;
+  }
+}
+
+static int compare(const void *a, const void *b) {
+  unsigned long x = *(const unsigned long *)a;
+  unsigned long y = *(const unsigned long *)b;
+  return x < y ? -1 : x > y;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s bench.elf\n", argv[0]);
+    return 2;
+  }
+  elf_firmware_t firmware;
+  memset(&firmware, 0, sizeof(firmware));
+  if (elf_read_firmware(argv[1], &firmware)) {
+    fprintf(stderr, "%s: cannot read firmware\n", argv[1]);
+    return 2;
+  }
+  avr = avr_make_mcu_by_name("atmega328p");
+  if (!avr) {
+    fprintf(stderr, "simavr has no atmega328p\n");
+    return 2;
+  }
+  avr_init(avr);
+  avr_load_firmware(avr, &firmware);
+  avr->frequency = 16000000;
+
+  pinA = avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('D'), 2);
+  pinB = avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('D'), 3);
+  pinButton = avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('D'), 4);
+  avr_raise_irq(pinA, 0);
+  avr_raise_irq(pinB, 0);
+  avr_raise_irq(pinButton, 1);
+  avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), 4), requestChanged, NULL);
+  avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), 5), markChanged, NULL);
+
+  for (;;) {
+    int state = avr_run(avr);
+    if (state == cpu_Done || state == cpu_Crashed) {
+      if (state == cpu_Crashed) {
+        fprintf(stderr, "firmware crashed at pc 0x%04x\n", (unsigned int)avr->pc);
+        return 1;
+      }
+      break;
+    }
+    if (watching == 1 && (avr->pc == INT0_VECTOR || avr->pc == INT1_VECTOR)) {
+      entryCycle = avr->cycle;
+      watching = 2;
+    }
+    else if (watching == 2 && avr->sreg[S_I]) {
+      record(watchId, (unsigned long)(avr->cycle - entryCycle), (unsigned long)(entryCycle - raiseCycle));
+      watching = 0;
+    }
+  }
+
+  unsigned long baseline = 0;
+  if (counts[BENCH_EMPTY]) {
+    qsort(samples[BENCH_EMPTY], counts[BENCH_EMPTY], sizeof(unsigned long), compare);
+    baseline = samples[BENCH_EMPTY][0];
+  }
+
+  printf("%-28s %6s %6s %6s %6s %8s\n", "cycles per call", "calls", "min", "median", "max", "latency");
+  for (int id = 1; id < BENCH_COUNT; id++) {
+    unsigned int n = counts[id];
+    if (!n) {
+      printf("%-28s %6s\n", names[id], "-");
+      continue;
+    }
+    bool isr = id == BENCH_ISR || id == BENCH_ISR_A;
+    unsigned long offset = isr ? 0 : baseline;
+    unsigned long worstWait = 0;
+    for (unsigned int i = 0; i < n; i++) {
+      if (latency[id][i] > worstWait) {
+        worstWait = latency[id][i];
+      }
+    }
+    qsort(samples[id], n, sizeof(unsigned long), compare);
+    printf("%-28s %6u %6lu %6lu %6lu", names[id], n, samples[id][0] - offset,
+           samples[id][n / 2] - offset, samples[id][n - 1] - offset);
+    if (isr) {
+      printf(" %8lu", worstWait);
+    }
+    printf("\n");
+  }
+  printf("\nsizeof(Rotary) %u bytes of SRAM per encoder\n", avr->data[GPIOR1_ADDR]);
+  printf("min and median exclude the odd Timer0 (millis) interrupt; max may not\n");
+  return 0;
+}
@@ -0,0 +1,123 @@
+/*
+ * Minimal stand-in for the Arduino core, for building the library and
+ * its tools on a desktop host:
+ *
+ *   g++ -std=c++17 -O2 -pthread -I extras/host rotary.cpp ... your.cpp
+ *
+ * Pins are plain variables. Host code drives inputs with digitalWrite()
+ * (which is also what the library uses to enable pull-ups, so inputs
+ * idle high). A handler attached with attachInterrupt() runs straight
+ * away on the thread that changed the pin, like a CHANGE interrupt.
+ * Interrupts are never really disabled, so noInterrupts() is a no-op.
+ * Time is the real clock, unless a simulation takes it over with
+ * hostSetMicros().
+ */
+
+#ifndef host_arduino_h
+#define host_arduino_h
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+#define HOST_PINS 80
+
+// Analog pins as numbered on the Uno, for examples that use them.
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+inline std::atomic<unsigned char> hostPinLevels[HOST_PINS];
+inline void (*hostPinHandlers[HOST_PINS])();
+inline unsigned char hostPinModes[HOST_PINS];
+
+inline void pinMode(uint8_t pin, uint8_t mode) {
+  if (mode == INPUT_PULLUP) {
+    hostPinLevels[pin] = HIGH;
+  }
+}
+
+inline int digitalRead(uint8_t pin) {
+  return hostPinLevels[pin].load(std::memory_order_relaxed);
+}
+
+inline void digitalWrite(uint8_t pin, uint8_t val) {
+  unsigned char level = val ? HIGH : LOW;
+  unsigned char old = hostPinLevels[pin].exchange(level);
+  void (*handler)() = hostPinHandlers[pin];
+  if (handler && old != level) {
+    unsigned char mode = hostPinModes[pin];
+    if (mode == CHANGE || (mode == RISING && level) || (mode == FALLING && !level)) {
+      handler();
+    }
+  }
+}
+
+#define digitalPinToInterrupt(p) (p)
+
+inline void attachInterrupt(uint8_t interrupt, void (*handler)(), int mode) {
+  hostPinModes[interrupt] = mode;
+  hostPinHandlers[interrupt] = handler;
+}
+
+inline void detachInterrupt(uint8_t interrupt) {
+  hostPinHandlers[interrupt] = 0;
+}
+
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+inline std::chrono::steady_clock::time_point hostStartTime() {
+  static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  return start;
+}
+
+inline std::atomic<bool> hostClockManual;
+inline std::atomic<unsigned long> hostClockMicros;
+
+// Stops the clock at the given time; micros() and millis() return it
+// until the next call.
+inline void hostSetMicros(unsigned long us) {
+  hostClockMicros = us;
+  hostClockManual = true;
+}
+
+inline unsigned long micros() {
+  if (hostClockManual) {
+    return hostClockMicros;
+  }
+  return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - hostStartTime()).count();
+}
+
+inline unsigned long millis() {
+  return micros() / 1000;
+}
+
+inline void delay(unsigned long ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+inline void delayMicroseconds(unsigned int us) {
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+#endif
@@ -0,0 +1,74 @@
+/*
+ * Stand-in for the Wire library in slave mode, for running sketches that
+ * serve I2C requests on a desktop host.
+ *
+ * Host code plays the master. hostWireWrite() delivers a write to the
+ * sketch's onReceive() handler. hostWireRead() runs its onRequest()
+ * handler and returns the bytes the master clocks out. Bytes queued
+ * beyond that are dropped, as on the bus.
+ */
+
+#ifndef host_wire_h
+#define host_wire_h
+
+#include "Arduino.h"
+
+#define HOST_WIRE_BUFFER 32
+
+class TwoWire
+{
+  public:
+    void begin(uint8_t address) { slaveAddress = address; }
+    void onReceive(void (*handler)(int)) { receiveHandler = handler; }
+    void onRequest(void (*handler)()) { requestHandler = handler; }
+
+    int available() { return rxLength - rxIndex; }
+    int read() { return rxIndex < rxLength ? rxBuffer[rxIndex++] : -1; }
+
+    size_t write(uint8_t value) {
+      if (txLength >= HOST_WIRE_BUFFER) {
+        return 0;
+      }
+      txBuffer[txLength++] = value;
+      return 1;
+    }
+
+    // Master writes count bytes, ended by a stop or a repeated start.
+    void hostWireWrite(const uint8_t *data, uint8_t count) {
+      memcpy(rxBuffer, data, count);
+      rxLength = count;
+      rxIndex = 0;
+      if (receiveHandler) {
+        receiveHandler(count);
+      }
+    }
+
+    // Master reads count bytes. Returns how many the sketch queued, of
+    // which at most count are copied; the rest of data reads 0xff, as an
+    // idle bus does.
+    uint8_t hostWireRead(uint8_t *data, uint8_t count) {
+      txLength = 0;
+      if (requestHandler) {
+        requestHandler();
+      }
+      for (uint8_t i = 0; i < count; i++) {
+        data[i] = i < txLength ? txBuffer[i] : 0xff;
+      }
+      return txLength;
+    }
+
+    uint8_t slaveAddress = 0;
+
+  private:
+    void (*receiveHandler)(int) = 0;
+    void (*requestHandler)() = 0;
+    uint8_t rxBuffer[HOST_WIRE_BUFFER];
+    uint8_t rxLength = 0;
+    uint8_t rxIndex = 0;
+    uint8_t txBuffer[HOST_WIRE_BUFFER];
+    uint8_t txLength = 0;
+};
+
+inline TwoWire Wire;
+
+#endif
@@ -0,0 +1,142 @@
+/*
+ * Host check of RotaryAngle.
+ *
+ *   g++ -std=c++17 -O2 -pthread -I extras/host -I . rotary_angle.cpp \
+ *       extras/host/angle_bench.cpp -o angle_bench
+ *   ./angle_bench [moves]
+ *
+ * For a range of counts per revolution, including primes and counts that
+ * do not divide 360, compares the angle of every count against the exact
+ * angle rounded to the nearest 16.16 unit. Then moves a position about at
+ * random, mostly a step at a time with the odd jump of many revolutions,
+ * tracking it once with step() and once with update(). Both are checked
+ * after every move against the count and revolutions found by division.
+ * Last, times a step and an angle read against working them out from the
+ * position with 32-bit divisions.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include "Arduino.h"
+#include "rotary_angle.h"
+
+static unsigned long long seed = 1;
+
+static unsigned long randomNumber(unsigned long range) {
+  seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+  return (seed >> 33) % range;
+}
+
+static double seconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Count and revolutions of a position, rounding towards minus infinity.
+static void reference(long position, long counts, long &count, long &revolutions) {
+  revolutions = position / counts;
+  count = position % counts;
+  if (count < 0) {
+    count += counts;
+    revolutions--;
+  }
+}
+
+int main(int argc, char **argv) {
+  unsigned long moves = argc > 1 ? atol(argv[1]) : 2000000;
+  static const unsigned int cprs[] = {1,   3,    7,    24,   96,    100,   360,
+                                      361, 1000, 1024, 2400, 10007, 36000, 65535};
+  const unsigned int n = sizeof(cprs) / sizeof(cprs[0]);
+  bool ok = true;
+
+  printf("%8s %14s %14s\n", "counts", "max error", "max angle");
+  for (unsigned int i = 0; i < n; i++) {
+    RotaryAngle angle = RotaryAngle(cprs[i]);
+    long long worst = 0;
+    long highest = 0;
+    for (unsigned long count = 0; count < cprs[i]; count++) {
+      long long exact = ((long long)count * (360LL << 17) + cprs[i]) / (2LL * cprs[i]);
+      long got = angle.degreesAt(count);
+      long long error = got > exact ? got - exact : exact - got;
+      if (error > worst) {
+        worst = error;
+      }
+      if (got > highest) {
+        highest = got;
+      }
+    }
+    bool good = worst <= 1 && highest < 360 * ROTARY_DEGREE;
+    ok &= good;
+    printf("%8u %10lld/2^16 %14.6f  %s\n", cprs[i], worst, highest / (double)ROTARY_DEGREE,
+           good ? "PASS" : "FAIL");
+  }
+
+  printf("\n%lu random moves per count\n", moves);
+  for (unsigned int i = 0; i < n; i++) {
+    RotaryAngle stepped = RotaryAngle(cprs[i]);
+    RotaryAngle updated = RotaryAngle(cprs[i]);
+    long position = 0;
+    unsigned long wrong = 0;
+    for (unsigned long m = 0; m < moves; m++) {
+      long delta;
+      if (randomNumber(1000) == 0) {
+        // A jump, as after a missed read
+        delta = (long)randomNumber(20 * cprs[i] + 1) - 10 * (long)cprs[i];
+        for (long s = 0; s < labs(delta); s++) {
+          stepped.step(delta > 0 ? DIR_CW : DIR_CCW);
+        }
+      }
+      else {
+        delta = randomNumber(2) ? 1 : -1;
+        stepped.step(delta > 0 ? DIR_CW : DIR_CCW | DIR_INFERRED);
+      }
+      position += delta;
+      updated.update(position);
+      long count, revolutions;
+      reference(position, cprs[i], count, revolutions);
+      long r, d;
+      updated.read(r, d);
+      if (stepped.count() != count || stepped.revolutions() != revolutions ||
+          updated.count() != count || r != revolutions || d != updated.degreesAt(count)) {
+        wrong++;
+      }
+    }
+    ok &= !wrong;
+    printf("%8u  position %9ld  revolutions %7ld  wrong %lu  %s\n", cprs[i], position,
+           stepped.revolutions(), wrong, wrong ? "FAIL" : "PASS");
+  }
+
+  // Cost per step: the tracker against dividing the position each time, in
+  // 32 bits as on AVR. The counts come through a volatile so that the
+  // compiler cannot turn the divisions into multiplies.
+  volatile unsigned int volatileCounts = 1000;
+  const unsigned int counts = volatileCounts;
+  const unsigned long rounds = 100000000;
+  RotaryAngle angle = RotaryAngle(counts);
+  uint32_t sum = 0;
+  double start = seconds();
+  for (unsigned long i = 0; i < rounds; i++) {
+    angle.step((i & 0x100) ? DIR_CCW : DIR_CW);
+    sum += angle.degreesAt(angle.count());
+  }
+  double tracked = (seconds() - start) * 1e9 / rounds;
+  uint32_t check = 0;
+  int32_t position = 0;
+  start = seconds();
+  for (unsigned long i = 0; i < rounds; i++) {
+    position += (i & 0x100) ? -1 : 1;
+    int32_t revolutions = position / (int32_t)volatileCounts;
+    int32_t count = position % (int32_t)volatileCounts;
+    if (count < 0) {
+      count += counts;
+      revolutions--;
+    }
+    check += ((uint32_t)count * (360UL << 16)) / counts + revolutions;
+  }
+  double divided = (seconds() - start) * 1e9 / rounds;
+  printf("\nstep and angle %.2f ns, dividing %.2f ns (%u %u)\n", tracked, divided, sum, check);
+  printf("\nresult %s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+/*
+ * Press latency of buttonPressedLeading() against buttonPressedReleased().
+ *
+ *   g++ -std=c++17 -O2 -pthread -I extras/host -I . rotary.cpp \
+ *       extras/host/button_latency.cpp -o button_latency
+ *   ./button_latency [samplePeriodMicros] [bounceMicros] [holdMillis]
+ *
+ * Two buttons on pins 4 and 5 get the same scripted presses in real time:
+ * each edge bounces every 100 us for bounceMicros, and the button is held
+ * for holdMillis. The main loop samples both every samplePeriodMicros,
+ * one with each method and a 20 ms debounce / lockout, and times the
+ * first report of each press from its first falling edge. Any further
+ * report in the same press cycle is counted as extra. Every press must be
+ * reported, and the leading-edge method must not report extras.
+ */
+
+#include <stdio.h>
+#include "Arduino.h"
+#include "rotary.h"
+
+#define PRESSES 20
+#define DEBOUNCE 20
+#define BOUNCE_PERIOD 100
+#define IDLE_MILLIS 100
+
+static Rotary trailing(2, 3, 4);
+static Rotary leading(6, 7, 5);
+
+struct Latency {
+  unsigned long reports;
+  unsigned long extra;
+  unsigned long cycle;
+  unsigned long total;
+  unsigned long worst;
+  unsigned long best;
+};
+
+static void record(Latency &latency, unsigned long cycle, unsigned long elapsed) {
+  if (latency.reports && latency.cycle == cycle) {
+    latency.extra++;
+    return;
+  }
+  latency.cycle = cycle;
+  latency.total += elapsed;
+  if (!latency.reports || elapsed > latency.worst) {
+    latency.worst = elapsed;
+  }
+  if (!latency.reports || elapsed < latency.best) {
+    latency.best = elapsed;
+  }
+  latency.reports++;
+}
+
+// Button level at time t into a press cycle: bouncing, held, bouncing
+// again on release, then open.
+static unsigned char level(unsigned long t, unsigned long bounce, unsigned long hold) {
+  if (t < bounce) {
+    return (t / BOUNCE_PERIOD) & 1;
+  }
+  if (t < hold) {
+    return LOW;
+  }
+  if (t < hold + bounce) {
+    return !((t - hold) / BOUNCE_PERIOD & 1);
+  }
+  return HIGH;
+}
+
+static void report(const char *name, const Latency &latency) {
+  if (!latency.reports) {
+    printf("%-28s %7lu %7lu\n", name, latency.reports, latency.extra);
+    return;
+  }
+  printf("%-28s %7lu %7lu %8.2f %8.2f %8.2f ms\n", name, latency.reports, latency.extra,
+         latency.best / 1000.0, latency.total / 1000.0 / latency.reports,
+         latency.worst / 1000.0);
+}
+
+int main(int argc, char **argv) {
+  unsigned long period = argc > 1 ? atol(argv[1]) : 1000;
+  unsigned long bounce = argc > 2 ? atol(argv[2]) : 2000;
+  unsigned long hold = (argc > 3 ? atol(argv[3]) : 150) * 1000;
+  unsigned long cycle = hold + bounce + IDLE_MILLIS * 1000;
+
+  Latency trailingLatency = {0, 0, 0, 0, 0, 0};
+  Latency leadingLatency = {0, 0, 0, 0, 0, 0};
+  unsigned long start = micros();
+  unsigned long next = start;
+  for (;;) {
+    unsigned long now = micros() - start;
+    if (now >= PRESSES * cycle) {
+      break;
+    }
+    unsigned char pin = level(now % cycle, bounce, hold);
+    digitalWrite(4, pin);
+    digitalWrite(5, pin);
+    if (micros() - next < 0x80000000UL) {
+      next += period;
+      // A report belongs to the press that started in this cycle
+      if (trailing.buttonPressedReleased(DEBOUNCE)) {
+        record(trailingLatency, now / cycle, now % cycle);
+      }
+      if (leading.buttonPressedLeading(DEBOUNCE)) {
+        record(leadingLatency, now / cycle, now % cycle);
+      }
+    }
+  }
+
+  printf("sample period  %lu us, bounce %lu us, hold %lu ms, %d presses\n",
+         period, bounce, hold / 1000, PRESSES);
+  printf("%-28s %7s %7s %8s %8s %8s\n", "", "presses", "extra", "best", "mean", "worst");
+  report("buttonPressedReleased(20)", trailingLatency);
+  report("buttonPressedLeading(20)", leadingLatency);
+  bool ok = trailingLatency.reports == PRESSES && leadingLatency.reports == PRESSES &&
+            leadingLatency.extra == 0;
+  printf("result         %s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
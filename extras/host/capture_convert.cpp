@@ -0,0 +1,301 @@
+/*
+ * Converts captures to the transition format and decodes them.
+ *
+ *   g++ -std=c++17 -O2 -pthread -I extras/host -I . rotary.cpp \
+ *       extras/host/rotary_capture.cpp extras/host/capture_convert.cpp \
+ *       -o capture_convert
+ *
+ *   capture_convert raw <capture> <output> [-p periodNanos]
+ *       converts a raw capture (see rotary_capture.h)
+ *   capture_convert vcd <dump.vcd> <output> [-a name] [-b name] [-c name]
+ *       converts a value change dump, eg. from a logic analyser. The
+ *       signals default to A, B and BTN; the VCD time unit becomes the
+ *       sample period, and unknown levels read as high
+ *   capture_convert decode <capture>
+ *       decodes a transition or raw capture and prints the steps
+ *   capture_convert compare <raw capture> <transition capture>
+ *       decodes both and checks that every step matches, then compares
+ *       their sizes and decoding times
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include "Arduino.h"
+#include "rotary.h"
+#include "rotary_capture.h"
+
+static double seconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static unsigned long long fileSize(const char *path) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    return 0;
+  }
+  fseeko(file, 0, SEEK_END);
+  unsigned long long size = ftello(file);
+  fclose(file);
+  return size;
+}
+
+static int fromRaw(const char *in, const char *out, unsigned long long periodNanos) {
+  FILE *raw = fopen(in, "rb");
+  if (!raw) {
+    perror(in);
+    return 2;
+  }
+  std::vector<unsigned char> chunk(65536);
+  size_t got = fread(chunk.data(), 1, chunk.size(), raw);
+  RotaryTransitionWriter writer;
+  if (!writer.open(out, got ? chunk[0] : 0, periodNanos * 1000)) {
+    perror(out);
+    return 2;
+  }
+  unsigned long long sample = 0;
+  bool ok = true;
+  while (got && ok) {
+    for (size_t i = 0; i < got && ok; i++) {
+      ok = writer.add(sample + i, chunk[i]);
+    }
+    sample += got;
+    got = fread(chunk.data(), 1, chunk.size(), raw);
+  }
+  fclose(raw);
+  ok = writer.close(sample) && ok;
+  if (!ok) {
+    fprintf(stderr, "%s: write failed\n", out);
+    return 2;
+  }
+  printf("%llu samples, %llu transitions\n", sample, writer.transitions());
+  return 0;
+}
+
+// Picoseconds in a VCD time unit, eg. "10ns". 0 if below a picosecond.
+static unsigned long long timescalePicos(const std::string &text) {
+  char *unit;
+  unsigned long long count = strtoull(text.c_str(), &unit, 10);
+  static const char *units[] = {"ps", "ns", "us", "ms", "s"};
+  unsigned long long scale = 1;
+  for (unsigned char i = 0; i < 5; i++, scale *= 1000) {
+    if (std::string(unit) == units[i]) {
+      return (count ? count : 1) * scale;
+    }
+  }
+  return 0;
+}
+
+static int fromVcd(const char *in, const char *out, const std::string names[3]) {
+  FILE *vcd = fopen(in, "r");
+  if (!vcd) {
+    perror(in);
+    return 2;
+  }
+  std::string ids[3];
+  std::string timescale;
+  char word[256];
+  // Declarations, up to $enddefinitions
+  while (fscanf(vcd, "%255s", word) == 1) {
+    std::string token = word;
+    if (token == "$timescale") {
+      while (fscanf(vcd, "%255s", word) == 1 && std::string(word) != "$end") {
+        timescale += word;
+      }
+    }
+    else if (token == "$var") {
+      char type[64], size[16], id[64], name[128];
+      if (fscanf(vcd, "%63s %15s %63s %127s", type, size, id, name) == 4) {
+        for (unsigned char i = 0; i < 3; i++) {
+          if (names[i] == name) {
+            ids[i] = id;
+          }
+        }
+      }
+    }
+    else if (token == "$enddefinitions") {
+      break;
+    }
+  }
+  if (ids[0].empty() || ids[1].empty()) {
+    fprintf(stderr, "%s: no signals named %s and %s\n", in, names[0].c_str(), names[1].c_str());
+    fclose(vcd);
+    return 2;
+  }
+
+  // Value changes. Levels start high (pull-ups) until the dump says
+  // otherwise, and sample 0 is the first timestamp.
+  unsigned char levels = ROTARY_CAPTURE_LEVELS;
+  unsigned long long base = 0;
+  unsigned long long time = 0;
+  bool timed = false;
+  bool started = false;
+  RotaryTransitionWriter writer;
+  bool ok = true;
+  while (ok && fscanf(vcd, "%255s", word) == 1) {
+    std::string token = word;
+    if (token[0] == '#') {
+      unsigned long long next = strtoull(word + 1, 0, 10);
+      if (!timed) {
+        base = next;
+        timed = true;
+      }
+      else if (next > time && !started) {
+        // The levels at the first timestamp are the initial ones
+        if (!writer.open(out, levels, timescalePicos(timescale))) {
+          perror(out);
+          fclose(vcd);
+          return 2;
+        }
+        started = true;
+      }
+      else if (next > time) {
+        ok = writer.add(time - base, levels);
+      }
+      time = next;
+    }
+    else if (token[0] == '0' || token[0] == '1' || token[0] == 'x' || token[0] == 'X' ||
+             token[0] == 'z' || token[0] == 'Z') {
+      std::string id = token.substr(1);
+      for (unsigned char i = 0; i < 3; i++) {
+        if (id == ids[i]) {
+          unsigned char bit = i == 2 ? ROTARY_CAPTURE_BUTTON : 1 << i;
+          levels = token[0] == '0' ? levels & ~bit : levels | bit;
+        }
+      }
+    }
+    else if (token[0] == 'b' || token[0] == 'r') {
+      // Vector or real value: skip its identifier
+      ok = fscanf(vcd, "%255s", word) == 1;
+    }
+  }
+  fclose(vcd);
+  if (!timed) {
+    fprintf(stderr, "%s: no value changes\n", in);
+    return 2;
+  }
+  if (!started) {
+    started = writer.open(out, levels, timescalePicos(timescale));
+  }
+  else {
+    ok = ok && writer.add(time - base, levels);
+  }
+  ok = ok && started && writer.close(time - base + 1);
+  if (!ok) {
+    fprintf(stderr, "%s: write failed\n", out);
+    return 2;
+  }
+  printf("%llu samples of %llu ps, %llu transitions\n", time - base + 1,
+         timescalePicos(timescale), writer.transitions());
+  return 0;
+}
+
+struct Steps {
+  std::vector<unsigned long long> samples;
+  std::vector<unsigned char> directions;
+  bool print;
+};
+
+static void recordStep(void *context, unsigned long long sample, unsigned char direction) {
+  Steps *steps = (Steps *)context;
+  if (steps->print) {
+    printf("%12llu  %s\n", sample, direction == DIR_CW ? "cw" : "ccw");
+  }
+  else {
+    steps->samples.push_back(sample);
+    steps->directions.push_back(direction);
+  }
+}
+
+static int decode(const char *path) {
+  Steps steps;
+  steps.print = true;
+  RotaryTransitionReader reader;
+  if (reader.open(path)) {
+    if (!reader.decode(recordStep, &steps)) {
+      fprintf(stderr, "%s: truncated or corrupt\n", path);
+      return 2;
+    }
+    printf("%llu samples, %llu transitions, position %ld\n", reader.samples(),
+           reader.transitions(), reader.position());
+    return 0;
+  }
+  RotaryReplay replay;
+  if (!replay.open(path)) {
+    perror(path);
+    return 2;
+  }
+  replay.decode(replay.samples(), recordStep, &steps);
+  printf("%llu samples, position %ld\n", replay.samples(), replay.position());
+  return 0;
+}
+
+static int compare(const char *rawPath, const char *transitionPath) {
+  RotaryReplay replay;
+  RotaryTransitionReader reader;
+  if (!replay.open(rawPath) || !reader.open(transitionPath)) {
+    fprintf(stderr, "cannot open the captures\n");
+    return 2;
+  }
+  Steps raw;
+  Steps transitions;
+  raw.print = transitions.print = false;
+  double start = seconds();
+  replay.decode(replay.samples(), recordStep, &raw);
+  double rawTime = seconds() - start;
+  start = seconds();
+  bool ok = reader.decode(recordStep, &transitions);
+  double transitionTime = seconds() - start;
+  ok = ok && replay.samples() == reader.samples() && replay.position() == reader.position() &&
+       replay.button() == reader.button() && raw.samples == transitions.samples &&
+       raw.directions == transitions.directions;
+
+  unsigned long long rawSize = fileSize(rawPath);
+  unsigned long long transitionSize = fileSize(transitionPath);
+  printf("samples         %llu\n", replay.samples());
+  printf("transitions     %llu\n", reader.transitions());
+  printf("steps           %zu, position %ld\n", raw.samples.size(), replay.position());
+  printf("size            %llu -> %llu bytes (%.0fx smaller)\n", rawSize, transitionSize,
+         (double)rawSize / transitionSize);
+  printf("decode time     %.3f s raw, %.3f s transitions\n", rawTime, transitionTime);
+  printf("result          %s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+  std::string command = argc > 1 ? argv[1] : "";
+  if (command == "raw" && argc > 3) {
+    unsigned long long period = 0;
+    if (argc > 5 && std::string(argv[4]) == "-p") {
+      period = strtoull(argv[5], 0, 0);
+    }
+    return fromRaw(argv[2], argv[3], period);
+  }
+  if (command == "vcd" && argc > 3) {
+    std::string names[3] = {"A", "B", "BTN"};
+    for (int i = 4; i + 1 < argc; i += 2) {
+      std::string option = argv[i];
+      if (option == "-a") {
+        names[0] = argv[i + 1];
+      }
+      else if (option == "-b") {
+        names[1] = argv[i + 1];
+      }
+      else if (option == "-c") {
+        names[2] = argv[i + 1];
+      }
+    }
+    return fromVcd(argv[2], argv[3], names);
+  }
+  if (command == "decode" && argc > 2) {
+    return decode(argv[2]);
+  }
+  if (command == "compare" && argc > 3) {
+    return compare(argv[2], argv[3]);
+  }
+  fprintf(stderr, "usage: %s raw|vcd|decode|compare ...\n", argv[0]);
+  return 2;
+}
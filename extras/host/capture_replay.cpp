@@ -0,0 +1,240 @@
+/*
+ * Builds checkpoint indexes for raw captures and replays them from any
+ * point.
+ *
+ *   g++ -std=c++17 -O2 -pthread -I extras/host -I . rotary.cpp \
+ *       extras/host/rotary_capture.cpp extras/host/capture_replay.cpp \
+ *       -o capture_replay
+ *
+ *   capture_replay generate <capture> <samples>
+ *       writes a synthetic capture: an encoder turning back and forth at
+ *       varying speed, with contact bounce, and occasional button presses
+ *   capture_replay index <capture> [interval]
+ *       writes <capture>.idx with a checkpoint every interval samples
+ *   capture_replay seek <capture> <sample> [count] [-p periodNanos]
+ *       restores the state before sample, using the index if there is
+ *       one, then lists the steps in the next count samples. With the
+ *       sample period given, <sample> can also be a time such as 3600s
+ *   capture_replay verify <capture> [seeks]
+ *       seeks to random samples with and without the index and checks
+ *       that both give the same position and button level as one pass
+ *       from the start, and times them
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "Arduino.h"
+#include "rotary.h"
+#include "rotary_capture.h"
+
+static unsigned long long seed = 1;
+
+static unsigned long randomNumber(unsigned long range) {
+  seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+  return (seed >> 33) % range;
+}
+
+static double seconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Clockwise Gray sequence as (pin2 << 1) | pin1, from rest on 00.
+static const unsigned char cwSequence[4] = {0, 2, 3, 1};
+
+static int generate(const char *path, unsigned long long total) {
+  FILE *out = fopen(path, "wb");
+  if (!out) {
+    perror(path);
+    return 2;
+  }
+  std::vector<unsigned char> chunk(65536);
+  unsigned long long quarter = 0;
+  int direction = 1;
+  unsigned long gap = 200;
+  unsigned long wait = gap;
+  unsigned char bounce = 0;
+  unsigned char button = ROTARY_CAPTURE_BUTTON;
+  unsigned char code = 0;
+  for (unsigned long long sample = 0; sample < total;) {
+    size_t count = 0;
+    for (; count < chunk.size() && sample < total; count++, sample++) {
+      if (!--wait) {
+        // Next transition; now and then turn round, speed up or pause
+        if (!randomNumber(64)) {
+          direction = -direction;
+        }
+        if (!randomNumber(32)) {
+          gap = 20 + randomNumber(2000);
+        }
+        quarter += direction;
+        wait = !randomNumber(256) ? 100000 : gap;
+        bounce = randomNumber(4) * 2;
+        if (!randomNumber(512)) {
+          button ^= ROTARY_CAPTURE_BUTTON;
+        }
+      }
+      unsigned char next = cwSequence[quarter & 3];
+      if (bounce) {
+        // Contact bounce: flick back to the previous code
+        bounce--;
+        next = bounce & 1 ? code : next;
+      }
+      else {
+        code = next;
+      }
+      chunk[count] = next | button;
+    }
+    fwrite(chunk.data(), 1, count, out);
+  }
+  return fclose(out) == 0 ? 0 : 2;
+}
+
+static int buildIndex(const char *path, unsigned long interval) {
+  RotaryReplay replay;
+  if (!replay.open(path)) {
+    perror(path);
+    return 2;
+  }
+  double start = seconds();
+  if (!replay.buildIndex(interval)) {
+    fprintf(stderr, "%s.idx: cannot write\n", path);
+    return 2;
+  }
+  printf("%llu samples, %lu checkpoints every %lu samples, %.2f s\n",
+         replay.samples(), replay.checkpoints(), interval, seconds() - start);
+  return 0;
+}
+
+struct Listing {
+  unsigned long long period;
+};
+
+static void listStep(void *context, unsigned long long sample, unsigned char direction) {
+  Listing *listing = (Listing *)context;
+  if (listing->period) {
+    printf("%12.6f s  ", sample * listing->period / 1e9);
+  }
+  printf("%12llu  %s\n", sample, direction == DIR_CW ? "cw" : "ccw");
+}
+
+static int seek(const char *path, unsigned long long sample, unsigned long long count, unsigned long long period) {
+  RotaryReplay replay;
+  if (!replay.open(path)) {
+    perror(path);
+    return 2;
+  }
+  bool indexed = replay.loadIndex();
+  double start = seconds();
+  if (!replay.seek(sample)) {
+    fprintf(stderr, "sample %llu is past the end (%llu samples)\n", sample, replay.samples());
+    return 2;
+  }
+  printf("seek to %llu %s index: %.3f ms, position %ld, button %s\n", sample,
+         indexed ? "with" : "without", (seconds() - start) * 1e3, replay.position(),
+         replay.button() ? "open" : "pressed");
+  Listing listing = {period};
+  replay.decode(count, listStep, &listing);
+  printf("position %ld at sample %llu\n", replay.position(), replay.tell());
+  return 0;
+}
+
+static int verify(const char *path, unsigned long seeks) {
+  RotaryReplay linear;
+  RotaryReplay indexed;
+  RotaryReplay unindexed;
+  if (!linear.open(path) || !indexed.open(path) || !unindexed.open(path)) {
+    perror(path);
+    return 2;
+  }
+  if (!indexed.loadIndex()) {
+    fprintf(stderr, "%s.idx: missing or stale, run index first\n", path);
+    return 2;
+  }
+  unsigned long long total = linear.samples();
+  std::vector<unsigned long long> targets(seeks);
+  for (unsigned long i = 0; i < seeks; i++) {
+    targets[i] = ((unsigned long long)randomNumber(1UL << 30) << 30 | randomNumber(1UL << 30)) % (total + 1);
+  }
+  std::vector<unsigned long long> sorted(targets);
+  std::sort(sorted.begin(), sorted.end());
+
+  // Reference: one pass from the start, stopping at each target in turn
+  std::vector<long> positions(seeks);
+  std::vector<unsigned char> buttons(seeks);
+  for (unsigned long i = 0; i < seeks; i++) {
+    linear.decode(sorted[i] - linear.tell(), 0, 0);
+    positions[i] = linear.position();
+    buttons[i] = linear.button();
+  }
+  bool ok = true;
+  double indexedTime = 0;
+  double unindexedTime = 0;
+  for (unsigned long i = 0; i < seeks; i++) {
+    unsigned long ref = std::lower_bound(sorted.begin(), sorted.end(), targets[i]) - sorted.begin();
+    double start = seconds();
+    ok &= indexed.seek(targets[i]);
+    indexedTime += seconds() - start;
+    start = seconds();
+    ok &= unindexed.seek(targets[i]);
+    unindexedTime += seconds() - start;
+    if (indexed.position() != positions[ref] || indexed.button() != buttons[ref] ||
+        unindexed.position() != positions[ref] || unindexed.button() != buttons[ref]) {
+      printf("mismatch at sample %llu\n", targets[i]);
+      ok = false;
+    }
+  }
+  printf("samples         %llu\n", total);
+  printf("checkpoints     %lu\n", indexed.checkpoints());
+  printf("random seeks    %lu\n", seeks);
+  printf("with index      %.3f ms per seek\n", indexedTime * 1e3 / seeks);
+  printf("without index   %.3f ms per seek\n", unindexedTime * 1e3 / seeks);
+  printf("result          %s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s generate|index|seek|verify <capture> ...\n", argv[0]);
+    return 2;
+  }
+  std::string command = argv[1];
+  const char *path = argv[2];
+  if (command == "generate" && argc > 3) {
+    return generate(path, strtoull(argv[3], 0, 0));
+  }
+  if (command == "index") {
+    return buildIndex(path, argc > 3 ? strtoul(argv[3], 0, 0) : ROTARY_INDEX_INTERVAL);
+  }
+  if (command == "seek" && argc > 3) {
+    unsigned long long count = 0;
+    unsigned long long period = 0;
+    for (int i = 4; i < argc; i++) {
+      if (std::string(argv[i]) == "-p" && i + 1 < argc) {
+        period = strtoull(argv[++i], 0, 0);
+      }
+      else {
+        count = strtoull(argv[i], 0, 0);
+      }
+    }
+    unsigned long long sample = strtoull(argv[3], 0, 0);
+    std::string target = argv[3];
+    if (target.back() == 's') {
+      if (!period) {
+        fprintf(stderr, "seeking to a time needs -p\n");
+        return 2;
+      }
+      sample = (unsigned long long)(atof(argv[3]) * 1e9 / period);
+    }
+    return seek(path, sample, count, period);
+  }
+  if (command == "verify") {
+    return verify(path, argc > 3 ? strtoul(argv[3], 0, 0) : 100);
+  }
+  fprintf(stderr, "usage: %s generate|index|seek|verify <capture> ...\n", argv[0]);
+  return 2;
+}
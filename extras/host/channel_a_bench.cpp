@@ -0,0 +1,161 @@
+/*
+ * Host comparison of single-channel and full interrupt decoding.
+ *
+ *   g++ -std=c++17 -O2 -pthread -I extras/host -I . rotary.cpp \
+ *       extras/host/channel_a_bench.cpp -o channel_a_bench
+ *   ./channel_a_bench [detents]
+ *
+ * Turns an encoder clockwise through the pins of the Arduino stand-in,
+ * with no bounce, or with every edge preceded by a bounce (two edges) on
+ * A or on B. Each run is decoded once with attachInterrupts() and once
+ * with attachInterruptA(), counting the interrupts taken, the position
+ * and the events returned. The runs are then repeated many times to time
+ * the handlers. The timed runs set the pin levels directly and call the
+ * handler attached to the pin that changed, and the time of the same runs
+ * with an empty handler is taken off, so only the handler's own work is
+ * left. Each time is the best of several runs. Build with HALF_STEP
+ * commented out in rotary.h for the full-step figures.
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include "Arduino.h"
+#include "rotary.h"
+
+// Clockwise Gray sequence as (pin2 << 1) | pin1, from rest on 00.
+static const unsigned char cwSequence[4] = {0, 2, 3, 1};
+
+Rotary encoder = Rotary(2, 3);
+
+static unsigned long interruptCount = 0;
+static unsigned long eventCount = 0;
+
+static void fullHandler() {
+  interruptCount++;
+  if (encoder.processInterrupt()) {
+    eventCount++;
+  }
+}
+
+static void channelAHandler() {
+  interruptCount++;
+  if (encoder.processChannelA()) {
+    eventCount++;
+  }
+}
+
+static double seconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Turns the encoder by the given detents. bounce is 0 for none, or the
+// pin that bounces before every edge.
+static void turn(unsigned long detents, unsigned char bounce) {
+  unsigned char quarter = 0;
+  for (unsigned long q = 0; q < 4 * detents; q++) {
+    if (bounce) {
+      digitalWrite(bounce, !digitalRead(bounce));
+      digitalWrite(bounce, !digitalRead(bounce));
+    }
+    unsigned char code = cwSequence[++quarter & 3];
+    digitalWrite(2, code & 1);
+    digitalWrite(3, code >> 1);
+  }
+}
+
+static void emptyHandler() {
+  interruptCount++;
+}
+
+// Sets a pin without the stand-in's dispatch, and calls the handler
+// directly if the pin has one.
+static inline void setPin(void (*const handlers[4])(), unsigned char pin, unsigned char level) {
+  if (hostPinLevels[pin].load(std::memory_order_relaxed) != level) {
+    hostPinLevels[pin].store(level, std::memory_order_relaxed);
+    if (handlers[pin]) {
+      handlers[pin]();
+    }
+  }
+}
+
+// Best time of a few runs of the same pin changes as turn(), with the
+// given handlers on pins 2 and 3.
+static double timeTurn(unsigned long detents, unsigned char bounce, void (*pin2)(), void (*pin3)()) {
+  void (*const handlers[4])() = {0, 0, pin2, pin3};
+  double best = 0;
+  for (unsigned char run = 0; run < 5; run++) {
+    double start = seconds();
+    unsigned char quarter = 0;
+    for (unsigned long q = 0; q < 4 * detents; q++) {
+      if (bounce) {
+        setPin(handlers, bounce, !digitalRead(bounce));
+        setPin(handlers, bounce, !digitalRead(bounce));
+      }
+      unsigned char code = cwSequence[++quarter & 3];
+      setPin(handlers, 2, code & 1);
+      setPin(handlers, 3, code >> 1);
+    }
+    double elapsed = seconds() - start;
+    if (!run || elapsed < best) {
+      best = elapsed;
+    }
+  }
+  return best;
+}
+
+static const char *modes[] = {"processInterrupt()", "processChannelA()"};
+static const char *bounces[] = {"none", "on A", "on B"};
+
+int main(int argc, char **argv) {
+  unsigned long detents = argc > 1 ? atol(argv[1]) : 1000;
+  const unsigned long timed = 1000000;
+  // Start at rest on 00 rather than on the pull-ups' 11
+  digitalWrite(2, LOW);
+  digitalWrite(3, LOW);
+  encoder.process();
+  printf("%lu detents clockwise, %s\n\n", detents,
+#ifdef HALF_STEP
+         "half step"
+#else
+         "full step"
+#endif
+  );
+  printf("%-20s %-6s %10s %10s %10s %12s %12s\n", "mode", "bounce", "interrupts",
+         "position", "events", "ns/interrupt", "ns/detent");
+
+  for (unsigned char b = 0; b < 3; b++) {
+    unsigned char bounce = b ? 1 + b : 0;
+    for (unsigned char m = 0; m < 2; m++) {
+      if (m) {
+        encoder.attachInterruptA(channelAHandler);
+      }
+      else {
+        encoder.attachInterrupts(fullHandler);
+      }
+      encoder.resetPosition();
+      interruptCount = 0;
+      eventCount = 0;
+      turn(detents, bounce);
+      unsigned long interrupts = interruptCount;
+      unsigned long events = eventCount;
+      long position = encoder.readPosition();
+
+      encoder.detachInterrupts();
+
+      // The same pin changes with an empty handler, to take off the cost
+      // of driving them
+      void (*handler)() = m ? channelAHandler : fullHandler;
+      void (*pin3)() = m ? 0 : handler;
+      void (*emptyPin3)() = m ? 0 : emptyHandler;
+      double baseline = timeTurn(timed, bounce, emptyHandler, emptyPin3);
+      interruptCount = 0;
+      double elapsed = timeTurn(timed, bounce, handler, pin3) - baseline;
+      unsigned long timedInterrupts = interruptCount / 5;
+      printf("%-20s %-6s %10lu %10ld %10lu %12.2f %12.2f\n", modes[m], bounces[b], interrupts,
+             position, events, elapsed * 1e9 / timedInterrupts, elapsed * 1e9 / timed);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,270 @@
+/*
+ * Host model of an encoder co-processor on an I2C bus.
+ *
+ *   g++ -std=c++17 -O2 -pthread -I extras/host -I . rotary.cpp \
+ *       rotary_group.cpp rotary_coprocessor.cpp \
+ *       extras/host/coprocessor_bus.cpp -o coprocessor_bus
+ *   ./coprocessor_bus [ticks] [busHz]
+ *
+ * Eight encoders with buttons are turned at random through the pins of
+ * the Arduino stand-in, and the co-processor polls them with
+ * RotaryGroup::processAll(). A modelled I2C master watches the interrupt
+ * line and reads the register map whenever it goes low, using one of
+ * three strategies:
+ *
+ *   burst      one read of every encoder block
+ *   status     read the status register, then each changed block
+ *   per-encoder  one read per encoder block, every block
+ *
+ * The master keeps its own count from the deltas. It must always agree
+ * with the positions it reads and, at the end, with the encoders. The
+ * bus model counts the bits on the wire (9 per byte, plus start, repeated
+ * start and stop) to give the bus time per update. First, two register
+ * checks: a button change on a block the master skips stays flagged, and
+ * a reset written to the control register takes effect at service().
+ */
+
+#include <stdio.h>
+#include "Arduino.h"
+#include "rotary.h"
+#include "rotary_group.h"
+#include "rotary_coprocessor.h"
+
+#define ENCODERS 8
+#define INT_PIN 40
+
+// Clockwise Gray sequence as (pin2 << 1) | pin1, from rest on 00.
+static const unsigned char cwSequence[4] = {0, 2, 3, 1};
+
+static unsigned long long seed = 1;
+
+static unsigned long randomNumber(unsigned long range) {
+  seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+  return (seed >> 33) % range;
+}
+
+// An I2C master talking to one co-processor. Each transaction writes the
+// register address, then reads with a repeated start.
+class I2cBusModel
+{
+  public:
+    I2cBusModel(RotaryCoprocessor &target) : device(target), bits(0), transactions(0) {}
+
+    void read(unsigned char address, unsigned char *data, unsigned char count) {
+      // START, device address + W, register, repeated START, device
+      // address + R, data bytes, STOP
+      bits += 1 + 9 + 9 + 1 + 9 + 9 * count + 1;
+      transactions++;
+      device.begin(address);
+      for (unsigned char i = 0; i < count; i++) {
+        data[i] = device.read();
+      }
+      device.end();
+    }
+
+    void write(unsigned char address, unsigned char value) {
+      // START, device address + W, register, value, STOP
+      bits += 1 + 9 + 9 + 9 + 1;
+      transactions++;
+      device.begin(address);
+      device.write(value);
+      device.end();
+    }
+
+    RotaryCoprocessor &device;
+    unsigned long long bits;
+    unsigned long transactions;
+};
+
+static long readLong(const unsigned char *bytes) {
+  return (long)(int32_t)(bytes[0] | bytes[1] << 8 | bytes[2] << 16 | (uint32_t)bytes[3] << 24);
+}
+
+static int readDelta(const unsigned char *bytes) {
+  return (int16_t)(bytes[0] | bytes[1] << 8);
+}
+
+struct Master {
+  long count[ENCODERS];
+  unsigned char button[ENCODERS];
+  unsigned long updates;
+  unsigned long errors;
+};
+
+// Takes one encoder block into the master's counts.
+static void takeBlock(Master &master, unsigned char i, const unsigned char *block) {
+  master.count[i] += readDelta(block + ROTARY_REG_DELTA);
+  if (master.count[i] != readLong(block + ROTARY_REG_POSITION)) {
+    master.errors++;
+  }
+  master.button[i] = block[ROTARY_REG_BUTTON];
+}
+
+static const char *strategies[] = {"burst", "status", "per-encoder"};
+
+static bool run(unsigned char strategy, unsigned long ticks, unsigned long busHz) {
+  seed = 1;
+  Rotary encoders[ENCODERS] = {
+    Rotary(2, 3, 20), Rotary(4, 5, 21), Rotary(6, 7, 22), Rotary(8, 9, 23),
+    Rotary(10, 11, 24), Rotary(12, 13, 25), Rotary(14, 15, 26), Rotary(16, 17, 27)
+  };
+  RotaryGroup group;
+  for (unsigned char i = 0; i < ENCODERS; i++) {
+    group.addWithButton(encoders[i]);
+    digitalWrite(2 + 2 * i, LOW);
+    digitalWrite(3 + 2 * i, LOW);
+    digitalWrite(20 + i, HIGH);
+  }
+  RotaryCoprocessor coprocessor(group);
+  coprocessor.setInterruptPin(INT_PIN);
+  I2cBusModel bus(coprocessor);
+  Master master = {{0}, {0}, 0, 0};
+  long quarters[ENCODERS] = {0};
+
+  unsigned char id[3];
+  bus.read(ROTARY_REG_ID, id, 3);
+  bool ok = id[0] == ROTARY_COPRO_ID && id[2] == ENCODERS;
+
+  for (unsigned long tick = 0; tick < ticks; tick++) {
+    // Usually one encoder moves a quarter-step, sometimes a button flips
+    unsigned char i = randomNumber(ENCODERS);
+    if (!randomNumber(50)) {
+      digitalWrite(20 + i, !digitalRead(20 + i));
+    }
+    else {
+      // Spin mostly one way, and always stop on a detent in the end
+      quarters[i] += randomNumber(3) ? 1 : -1;
+      unsigned char pins = cwSequence[quarters[i] & 3];
+      digitalWrite(2 + 2 * i, pins & 1);
+      digitalWrite(3 + 2 * i, pins >> 1);
+    }
+    group.processAll(1000);
+    coprocessor.service();
+
+    // The master only reads every few ticks, so changes pile up
+    if (tick % 4 || digitalRead(INT_PIN) == HIGH) {
+      continue;
+    }
+    master.updates++;
+    unsigned char blocks[ENCODERS * ROTARY_COPRO_STRIDE];
+    if (strategy == 0) {
+      bus.read(ROTARY_REG_ENCODERS, blocks, sizeof(blocks));
+      for (unsigned char e = 0; e < ENCODERS; e++) {
+        takeBlock(master, e, blocks + e * ROTARY_COPRO_STRIDE);
+      }
+    }
+    else if (strategy == 1) {
+      unsigned char status;
+      bus.read(ROTARY_REG_STATUS, &status, 1);
+      for (unsigned char e = 0; e < ENCODERS; e++) {
+        if (status & (1 << e)) {
+          bus.read(ROTARY_REG_ENCODERS + e * ROTARY_COPRO_STRIDE, blocks, ROTARY_COPRO_STRIDE);
+          takeBlock(master, e, blocks);
+        }
+      }
+    }
+    else {
+      for (unsigned char e = 0; e < ENCODERS; e++) {
+        bus.read(ROTARY_REG_ENCODERS + e * ROTARY_COPRO_STRIDE, blocks, ROTARY_COPRO_STRIDE);
+        takeBlock(master, e, blocks);
+      }
+    }
+  }
+
+  // Bring every encoder to rest on a detent and read once more
+  for (unsigned char i = 0; i < ENCODERS; i++) {
+    while (quarters[i] & 3) {
+      quarters[i]++;
+      unsigned char pins = cwSequence[quarters[i] & 3];
+      digitalWrite(2 + 2 * i, pins & 1);
+      digitalWrite(3 + 2 * i, pins >> 1);
+      group.processAll(1000);
+    }
+  }
+  coprocessor.service();
+  ok = ok && digitalRead(INT_PIN) == LOW;
+  unsigned char blocks[ENCODERS * ROTARY_COPRO_STRIDE];
+  bus.read(ROTARY_REG_ENCODERS, blocks, sizeof(blocks));
+  for (unsigned char e = 0; e < ENCODERS; e++) {
+    takeBlock(master, e, blocks + e * ROTARY_COPRO_STRIDE);
+    if (master.count[e] != encoders[e].readPosition() ||
+        master.button[e] != (digitalRead(20 + e) == LOW)) {
+      ok = false;
+    }
+  }
+  coprocessor.service();
+  ok = ok && master.errors == 0 && digitalRead(INT_PIN) == HIGH;
+
+  double busMicros = bus.bits * 1e6 / busHz;
+  printf("%-12s %8lu %12lu %10.1f %12.1f %8lu   %s\n", strategies[strategy], master.updates,
+         bus.transactions, (double)bus.bits / 8 / master.updates, busMicros / master.updates,
+         master.errors, ok ? "PASS" : "FAIL");
+  return ok;
+}
+
+// A button change on a block the master does not read must stay flagged,
+// and a reset written over the bus must take effect at service().
+static bool checkRegisters() {
+  Rotary first = Rotary(2, 3, 20);
+  Rotary second = Rotary(4, 5, 21);
+  RotaryGroup group;
+  group.addWithButton(first);
+  group.addWithButton(second);
+  for (unsigned char pin = 2; pin <= 5; pin++) {
+    digitalWrite(pin, LOW);
+  }
+  digitalWrite(20, HIGH);
+  digitalWrite(21, HIGH);
+  RotaryCoprocessor coprocessor(group);
+  coprocessor.setInterruptPin(INT_PIN);
+  I2cBusModel bus(coprocessor);
+  unsigned char block[ROTARY_COPRO_STRIDE];
+  bus.read(ROTARY_REG_ENCODERS, block, ROTARY_COPRO_STRIDE);
+  coprocessor.service();
+
+  // Press the second button, then read the first block only
+  digitalWrite(21, LOW);
+  coprocessor.service();
+  bus.read(ROTARY_REG_ENCODERS, block, ROTARY_COPRO_STRIDE);
+  coprocessor.service();
+  unsigned char status;
+  bus.read(ROTARY_REG_STATUS, &status, 1);
+  bool kept = status == 0x02 && digitalRead(INT_PIN) == LOW;
+  bus.read(ROTARY_REG_ENCODERS + ROTARY_COPRO_STRIDE, block, ROTARY_COPRO_STRIDE);
+  coprocessor.service();
+  kept = kept && block[ROTARY_REG_BUTTON] == 1 && digitalRead(INT_PIN) == HIGH;
+  printf("button on an unread block: status 0x%02x   %s\n", status, kept ? "PASS" : "FAIL");
+
+  // Turn the first encoder two detents and reset over the bus
+  static const unsigned char turn[8] = {2, 3, 1, 0, 2, 3, 1, 0};
+  for (unsigned char i = 0; i < 8; i++) {
+    digitalWrite(2, turn[i] & 1);
+    digitalWrite(3, turn[i] >> 1);
+    first.process();
+  }
+  long before = first.readPosition();
+  bus.write(ROTARY_REG_CONTROL, ROTARY_CONTROL_RESET);
+  long during = first.readPosition();
+  coprocessor.service();
+  bus.read(ROTARY_REG_ENCODERS, block, ROTARY_COPRO_STRIDE);
+  bool reset = before != 0 && during == before && first.readPosition() == 0 &&
+               readLong(block + ROTARY_REG_POSITION) == 0 && readDelta(block + ROTARY_REG_DELTA) == 0;
+  printf("reset: %ld before, %ld until service(), %ld after   %s\n\n", before, during,
+         first.readPosition(), reset ? "PASS" : "FAIL");
+  digitalWrite(21, HIGH);
+  return kept && reset;
+}
+
+int main(int argc, char **argv) {
+  unsigned long ticks = argc > 1 ? atol(argv[1]) : 100000;
+  unsigned long busHz = argc > 2 ? atol(argv[2]) : 400000;
+  bool ok = checkRegisters();
+  printf("%lu ticks, %d encoders, %lu Hz bus\n\n", ticks, ENCODERS, busHz);
+  printf("%-12s %8s %12s %10s %12s %8s\n", "strategy", "updates", "transactions",
+         "bytes/upd", "us/update", "errors");
+  for (unsigned char strategy = 0; strategy < 3; strategy++) {
+    ok &= run(strategy, ticks, busHz);
+  }
+  printf("\nresult %s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
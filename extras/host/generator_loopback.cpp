@@ -0,0 +1,124 @@
+/*
+ * Loopback of RotaryGenerator into the decoder.
+ *
+ *   g++ -std=c++17 -O2 -pthread -I extras/host -I . rotary.cpp \
+ *       rotary_generator.cpp extras/host/generator_loopback.cpp \
+ *       -o generator_loopback
+ *   ./generator_loopback [tickRate] [bounceTicks] [bounceChance]
+ *
+ * The generator drives pins 2 and 3, a button on pin 4 and an index pulse
+ * on pin 5 of the Arduino stand-in, ticking on a simulated clock. Two
+ * decoders read the same pins: one through interrupts, which sees every
+ * edge, and one polled once per tick. At each speed the generator turns
+ * out to a position and back with bounce on every edge, pressing the
+ * button on the way, and both decoders' positions are checked against it
+ * whenever it stops on a detent. The index pulses and the button presses
+ * seen by buttonPressedLeading() are checked too. The polled decoder is
+ * only expected to keep up while bounce ends within a quarter-step.
+ */
+
+#include <stdio.h>
+#include "Arduino.h"
+#include "rotary.h"
+#include "rotary_generator.h"
+
+#define REVOLUTION 96
+#define TRAVEL (20 * REVOLUTION)
+
+#ifdef HALF_STEP
+#define QUARTERS_PER_STEP 2
+#else
+#define QUARTERS_PER_STEP 4
+#endif
+
+Rotary interrupted = Rotary(2, 3, 4);
+Rotary polled = Rotary(2, 3);
+RotaryGenerator generator = RotaryGenerator(2, 3);
+
+static unsigned long indexPulses = 0;
+
+static void onIndex() {
+  indexPulses++;
+}
+
+struct Run {
+  long interruptedError;
+  long polledError;
+  unsigned long pressed;
+  unsigned long presses;
+};
+
+static unsigned long tick = 0;
+static unsigned long tickRate;
+
+// Ticks until the generator stops, then checks both decoders.
+static void settle(Run &run, long expected) {
+  unsigned long count = 0;
+  while (generator.moving()) {
+    hostSetMicros(tick++ * 1000000ULL / tickRate);
+    // Press the button now and then while turning
+    if (++count % 4000 == 1000) {
+      generator.press(true);
+      run.pressed++;
+    }
+    else if (count % 4000 == 3000) {
+      generator.press(false);
+    }
+    generator.tick();
+    polled.process();
+    if (interrupted.buttonPressedLeading(5)) {
+      run.presses++;
+    }
+  }
+  // Let the button and any bounce settle
+  generator.press(false);
+  for (unsigned char i = 0; i < 255; i++) {
+    hostSetMicros(tick++ * 1000000ULL / tickRate);
+    generator.tick();
+    polled.process();
+    if (interrupted.buttonPressedLeading(5)) {
+      run.presses++;
+    }
+  }
+  long steps = expected / QUARTERS_PER_STEP;
+  run.interruptedError += labs(interrupted.readPosition() - steps);
+  run.polledError += labs(polled.readPosition() - steps);
+}
+
+int main(int argc, char **argv) {
+  tickRate = argc > 1 ? atol(argv[1]) : 20000;
+  unsigned char bounceTicks = argc > 2 ? atoi(argv[2]) : 3;
+  unsigned char bounceChance = argc > 3 ? atoi(argv[3]) : 128;
+  generator.setButton(4);
+  generator.setIndex(5, REVOLUTION);
+  generator.begin(tickRate);
+  generator.setBounce(bounceTicks, bounceChance);
+  attachInterrupt(5, onIndex, RISING);
+  interrupted.attachInterrupts(rotaryInterrupt<interrupted>);
+
+  printf("tick rate %lu Hz, bounce %u ticks at %u/256, %d quarter-steps out and back\n\n",
+         tickRate, bounceTicks, bounceChance, TRAVEL);
+  printf("%14s %10s %14s %10s %10s %12s\n", "quarters/s", "ticks/q", "interrupt err",
+         "poll err", "index", "presses");
+  static const unsigned long speeds[] = {1000, 2000, 5000, 10000, 20000};
+  bool ok = true;
+  for (unsigned char s = 0; s < sizeof(speeds) / sizeof(speeds[0]); s++) {
+    unsigned long speed = speeds[s] * tickRate / 20000;
+    Run run = {0, 0, 0, 0};
+    unsigned long pulses = indexPulses;
+    generator.moveTo(TRAVEL, speed);
+    settle(run, TRAVEL);
+    generator.moveTo(0, speed);
+    settle(run, 0);
+    pulses = indexPulses - pulses;
+    // One rising index edge per revolution, each way
+    bool good = !run.interruptedError && pulses == 2 * TRAVEL / REVOLUTION &&
+                run.presses == run.pressed;
+    ok &= good;
+    printf("%14lu %10.1f %14ld %10ld %10lu %6lu / %-4lu %s\n", speed, (double)tickRate / speed,
+           run.interruptedError, run.polledError, pulses, run.presses, run.pressed,
+           good ? "PASS" : "FAIL");
+  }
+  printf("\nresult %s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
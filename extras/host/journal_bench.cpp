@@ -0,0 +1,96 @@
+/*
+ * Host check of RotaryJournal write amplification and power-loss recovery.
+ *
+ *   g++ -std=c++17 -O2 -I extras/host -I . rotary_journal.cpp \
+ *       extras/host/journal_bench.cpp -o journal_bench
+ *   ./journal_bench [journal file]
+ *
+ * Logs a stream of events into a file-backed journal under several sync
+ * policies. Each run stops without flushing, as a power loss would, then
+ * reopens the file and counts how many events begin() recovers. Reports
+ * write amplification (bytes written / bytes of events), the storage
+ * blocks used and the events lost for each policy.
+ */
+
+#include <stdio.h>
+#include "Arduino.h"
+#include "rotary_journal.h"
+#include "rotary_journal_file.h"
+
+#define EVENTS 10000
+// Enough for every run to fit without the ring wrapping
+#define STORAGE_BLOCKS 16384
+
+// Counts the events and blocks found in the journal, checking the events
+// come back in the order they were logged.
+static unsigned long recover(const char *path, unsigned long &blocks) {
+  RotaryJournalFile file;
+  file.open(path, STORAGE_BLOCKS);
+  RotaryJournal journal(file);
+  journal.begin();
+  unsigned long events = 0;
+  unsigned long last = 0;
+  unsigned char block[ROTARY_JOURNAL_BLOCK];
+  blocks = 0;
+  for (unsigned long sequence = 0; ; sequence++) {
+    if (!file.readBlock(sequence % STORAGE_BLOCKS, block) || !RotaryJournal::validBlock(block) ||
+        RotaryJournal::blockSequence(block) != sequence) {
+      break;
+    }
+    blocks++;
+    for (unsigned char i = 0; i < RotaryJournal::blockRecords(block); i++) {
+      RotaryEvent event;
+      RotaryJournal::readRecord(block, i, event);
+      if (events && event.time <= last) {
+        printf("  record %lu out of order\n", events);
+        return events;
+      }
+      last = event.time;
+      events++;
+    }
+  }
+  return events;
+}
+
+// Logs EVENTS events, calling idle() every idleEvery events and sync()
+// every syncEvery events (0 for never), then "loses power".
+static void run(const char *path, unsigned long idleEvery, unsigned long syncEvery) {
+  remove(path);
+  RotaryJournalFile file;
+  file.open(path, STORAGE_BLOCKS);
+  {
+    RotaryJournal journal(file);
+    journal.begin();
+    for (unsigned long i = 0; i < EVENTS; i++) {
+      RotaryEvent event = {i, (unsigned char)(i % 4), (unsigned char)(i & 1 ? DIR_CW : DIR_CCW)};
+      journal.log(event);
+      if (syncEvery && (i + 1) % syncEvery == 0) {
+        journal.sync();
+      }
+      else if ((i + 1) % idleEvery == 0) {
+        journal.idle();
+      }
+    }
+    unsigned long blocks;
+    unsigned long recovered = recover(path, blocks);
+    printf("%-14lu %-14lu %10lu %10lu %12.2f %8lu %8lu %8lu\n", idleEvery,
+           syncEvery, journal.bytesLogged(), journal.bytesWritten(),
+           (double)journal.bytesWritten() / journal.bytesLogged(), blocks,
+           journal.dropped(), EVENTS - journal.dropped() - recovered);
+  }
+}
+
+int main(int argc, char **argv) {
+  const char *path = argc > 1 ? argv[1] : "journal_bench.bin";
+  printf("%d events, %d records per block\n\n", EVENTS, ROTARY_JOURNAL_RECORDS);
+  printf("%-14s %-14s %10s %10s %12s %8s %8s %8s\n", "idle() every", "sync() every",
+         "logged", "written", "amplif.", "blocks", "dropped", "lost");
+  run(path, 10, 0);
+  run(path, 200, 0);
+  run(path, 10, 500);
+  run(path, 10, 100);
+  run(path, 10, 10);
+  run(path, 10, 1);
+  remove(path);
+  return 0;
+}
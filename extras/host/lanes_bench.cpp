@@ -0,0 +1,143 @@
+/*
+ * Button latency during fast spins, with one queue and with
+ * RotaryEventLanes.
+ *
+ *   g++ -std=c++17 -O2 -pthread -I extras/host -I . rotary_lanes.cpp \
+ *       extras/host/lanes_bench.cpp -o lanes_bench
+ *   ./lanes_bench [handlingMicros]
+ *
+ * Two encoders spin at a steady rate for two seconds of simulated time
+ * while their buttons are clicked now and then. The consumer takes
+ * handlingMicros to handle each event it reads, eg. to redraw a display.
+ * With a single first-in first-out queue every step is an event, so once
+ * steps come faster than they are handled a click waits behind all of
+ * them. With the lanes a click is read next, and the steps are delivered
+ * as one count per encoder. Reports the click latency from post to read,
+ * and checks that both deliver every step and every click.
+ */
+
+#include <stdio.h>
+#include <deque>
+#include "Arduino.h"
+#include "rotary_lanes.h"
+
+#define ENCODERS 2
+#define DURATION 2000000UL
+#define TICK 10
+
+static unsigned long long seed = 1;
+
+static unsigned long randomNumber(unsigned long range) {
+  seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+  return (seed >> 33) % range;
+}
+
+struct Result {
+  unsigned long clicks;
+  unsigned long long latency;
+  unsigned long worst;
+  long steps[ENCODERS];
+  unsigned long backlog;
+};
+
+// Runs one simulation. The producer side is the same for both; only how
+// events are queued and read differs.
+static Result simulate(bool lanes, unsigned long stepsPerSecond, unsigned long handling) {
+  seed = 1;
+  RotaryEventLanes priority;
+  std::deque<RotaryEvent> fifo;
+  Result result = {0, 0, 0, {0}, 0};
+  unsigned long stepPeriod = 1000000 / stepsPerSecond;
+  unsigned long nextStep[ENCODERS] = {0, stepPeriod / 2};
+  unsigned long nextClick = 50000;
+  unsigned long busyUntil = 0;
+  for (unsigned long now = 0; ; now += TICK) {
+    hostSetMicros(now);
+    bool producing = now < DURATION;
+    for (unsigned char e = 0; producing && e < ENCODERS; e++) {
+      while (nextStep[e] <= now) {
+        RotaryEvent step = {micros(), e, DIR_CW};
+        if (lanes) {
+          priority.post(step);
+        }
+        else {
+          fifo.push_back(step);
+        }
+        nextStep[e] += stepPeriod;
+      }
+    }
+    if (producing && nextClick <= now) {
+      RotaryEvent click = {micros(), (unsigned char)randomNumber(ENCODERS), EVENT_CLICK};
+      if (lanes) {
+        priority.post(click);
+      }
+      else {
+        fifo.push_back(click);
+      }
+      nextClick += 80000 + randomNumber(40000);
+    }
+    if (fifo.size() > result.backlog) {
+      result.backlog = fifo.size();
+    }
+    if (now < busyUntil) {
+      continue;
+    }
+    RotaryEvent event;
+    int steps = 1;
+    if (lanes) {
+      if (!priority.read(event, steps)) {
+        if (!producing) {
+          break;
+        }
+        continue;
+      }
+    }
+    else {
+      if (fifo.empty()) {
+        if (!producing) {
+          break;
+        }
+        continue;
+      }
+      event = fifo.front();
+      fifo.pop_front();
+    }
+    if (event.event == EVENT_CLICK) {
+      unsigned long waited = now - event.time;
+      result.clicks++;
+      result.latency += waited;
+      if (waited > result.worst) {
+        result.worst = waited;
+      }
+    }
+    else {
+      result.steps[event.source] += steps;
+    }
+    busyUntil = now + handling;
+  }
+  return result;
+}
+
+int main(int argc, char **argv) {
+  unsigned long handling = argc > 1 ? atol(argv[1]) : 2000;
+  static const unsigned long rates[] = {100, 400, 1000, 4000};
+  printf("%d encoders, %lu us to handle an event, %lu s simulated\n\n", ENCODERS, handling,
+         DURATION / 1000000);
+  printf("%10s %7s %14s %14s %9s %14s %14s\n", "steps/s", "clicks", "queue mean", "queue worst",
+         "backlog", "lanes mean", "lanes worst");
+  bool ok = true;
+  for (unsigned char r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+    Result fifo = simulate(false, rates[r], handling);
+    Result lanes = simulate(true, rates[r], handling);
+    long expected = DURATION / (1000000 / rates[r]);
+    for (unsigned char e = 0; e < ENCODERS; e++) {
+      ok &= fifo.steps[e] == expected && lanes.steps[e] == expected;
+    }
+    ok &= fifo.clicks == lanes.clicks && lanes.worst <= handling;
+    printf("%10lu %7lu %11.1f ms %11.1f ms %9lu %11.2f ms %11.2f ms\n", rates[r], lanes.clicks,
+           fifo.latency / 1000.0 / fifo.clicks, fifo.worst / 1000.0, fifo.backlog,
+           lanes.latency / 1000.0 / lanes.clicks, lanes.worst / 1000.0);
+  }
+  printf("\nresult %s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,152 @@
+/*
+ * Host check of the step/direction and up/down input modes.
+ *
+ *   g++ -std=c++17 -O2 -pthread -I extras/host -I . rotary.cpp \
+ *       extras/host/pulse_inputs.cpp -o pulse_inputs
+ *   ./pulse_inputs [pulses]
+ *
+ * Drives random pulse trains onto the pins of the Arduino stand-in, on a
+ * simulated clock: runs of step pulses with the direction line changed
+ * between runs, and separate clockwise and anti-clockwise pulse trains.
+ * Each mode is decoded by one encoder through interrupts and one that is
+ * polled after every pin change, and both positions are checked against
+ * the pulses sent. Step/direction must only take an interrupt on the step
+ * pin, and detaching must leave no handlers behind. readVelocity() is checked against the pulse rate, and
+ * the cost of process() is timed in each mode.
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include "Arduino.h"
+#include "rotary.h"
+
+// Pulse trains at 50 kHz: a 10 us pulse every 20 us
+#define PULSE_PERIOD 20
+
+Rotary stepInterrupt = Rotary(2, 3);
+Rotary stepPolled = Rotary(2, 3);
+Rotary upDownInterrupt = Rotary(4, 5);
+Rotary upDownPolled = Rotary(4, 5);
+
+static unsigned long long seed = 1;
+
+static unsigned long randomNumber(unsigned long range) {
+  seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+  return (seed >> 33) % range;
+}
+
+static double seconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static unsigned long now = 0;
+
+// Sets a pin at the given time, and lets the polled decoders sample.
+static void drive(unsigned char pin, unsigned char level, unsigned long at) {
+  now = at;
+  hostSetMicros(now);
+  digitalWrite(pin, level);
+  stepPolled.process();
+  upDownPolled.process();
+}
+
+static bool check(const char *name, long expected, Rotary &interrupted, Rotary &polled,
+                  long velocity) {
+  long speed = interrupted.readVelocity();
+  long want = 1000000 / PULSE_PERIOD;
+  bool ok = interrupted.readPosition() == expected && polled.readPosition() == expected &&
+            labs(labs(speed) - want) <= want / 100 && (speed > 0) == (velocity > 0);
+  printf("%-10s expected %8ld  interrupt %8ld  polled %8ld  velocity %7ld/s   %s\n", name,
+         expected, interrupted.readPosition(), polled.readPosition(), speed, ok ? "PASS" : "FAIL");
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  unsigned long pulses = argc > 1 ? atol(argv[1]) : 200000;
+  // Lines idle low, as from a push-pull driver, with the direction set
+  // clockwise
+  for (unsigned char pin = 2; pin <= 5; pin++) {
+    digitalWrite(pin, LOW);
+  }
+  digitalWrite(3, HIGH);
+  stepInterrupt.setInputMode(ROTARY_INPUT_STEP_DIR);
+  stepPolled.setInputMode(ROTARY_INPUT_STEP_DIR);
+  upDownInterrupt.setInputMode(ROTARY_INPUT_UP_DOWN);
+  upDownPolled.setInputMode(ROTARY_INPUT_UP_DOWN);
+  stepInterrupt.setRecovery(true);
+  upDownInterrupt.setRecovery(true);
+  printf("%lu pulses per mode at %d kHz\n\n", pulses, 1000 / PULSE_PERIOD);
+  // Only the step line needs an interrupt
+  stepInterrupt.attachInterruptA(rotaryInterruptA<stepInterrupt>);
+  upDownInterrupt.attachInterrupts(rotaryInterrupt<upDownInterrupt>);
+  bool ok = hostPinHandlers[2] && !hostPinHandlers[3];
+  printf("step/dir interrupts: pin 1 %s, pin 2 %s   %s\n", hostPinHandlers[2] ? "on" : "off",
+         hostPinHandlers[3] ? "on" : "off", ok ? "PASS" : "FAIL");
+
+
+
+  // Step/direction: runs of steps, the direction set up between runs
+  long expected = 0;
+  int direction = 1;
+  for (unsigned long sent = 0; sent < pulses;) {
+    if (!randomNumber(20)) {
+      direction = -direction;
+      drive(3, direction > 0, now + PULSE_PERIOD / 2);
+    }
+    drive(2, HIGH, now + PULSE_PERIOD / 2);
+    drive(2, LOW, now + PULSE_PERIOD / 2);
+    expected += direction;
+    sent++;
+  }
+  ok &= check("step/dir", expected, stepInterrupt, stepPolled, direction);
+
+  // Up/down: bursts of pulses on one line or the other
+  expected = 0;
+  unsigned char pin = 4;
+  for (unsigned long sent = 0; sent < pulses;) {
+    if (!randomNumber(20)) {
+      pin = pin == 4 ? 5 : 4;
+    }
+    drive(pin, HIGH, now + PULSE_PERIOD / 2);
+    drive(pin, LOW, now + PULSE_PERIOD / 2);
+    expected += pin == 4 ? 1 : -1;
+    sent++;
+  }
+  ok &= check("up/down", expected, upDownInterrupt, upDownPolled, pin == 4 ? 1 : -1);
+
+  // Detaching undoes exactly what was attached
+  stepInterrupt.detachInterrupts();
+  upDownInterrupt.detachInterrupts();
+  bool detached = true;
+  for (unsigned char p = 2; p <= 5; p++) {
+    detached &= !hostPinHandlers[p];
+  }
+  ok &= detached;
+  printf("\nafter detachInterrupts(): %s   %s\n", detached ? "no handlers left" : "handlers left",
+         detached ? "PASS" : "FAIL");
+
+  // Cost of process() in each mode, over a pin sequence for that mode
+  static const unsigned char quadrature[4] = {0, 2, 3, 1};
+  static const unsigned char stepDir[4] = {2, 3, 2, 3};
+  static const unsigned char upDown[4] = {0, 1, 0, 2};
+  static const unsigned char *sequences[3] = {quadrature, stepDir, upDown};
+  static const char *names[3] = {"quadrature", "step/dir", "up/down"};
+  static const unsigned char modes[3] = {ROTARY_INPUT_QUADRATURE, ROTARY_INPUT_STEP_DIR,
+                                         ROTARY_INPUT_UP_DOWN};
+  const unsigned long rounds = 50000000;
+  printf("\n");
+  for (unsigned char m = 0; m < 3; m++) {
+    Rotary timed = Rotary(10, 11);
+    timed.setInputMode(modes[m]);
+    double start = seconds();
+    for (unsigned long i = 0; i < rounds; i++) {
+      timed.process(sequences[m][i & 3]);
+    }
+    double ns = (seconds() - start) * 1e9 / rounds;
+    printf("%-10s process(pinstate) %.2f ns, position %ld\n", names[m], ns, timed.readPosition());
+  }
+  printf("\nresult %s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
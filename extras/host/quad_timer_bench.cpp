@@ -0,0 +1,227 @@
+/*
+ * Host check of RotaryQuadTimer against the register model of the timer.
+ *
+ *   g++ -std=c++17 -O2 -pthread -I extras/host -I . rotary.cpp \
+ *       rotary_quad_timer.cpp extras/host/quad_timer_bench.cpp \
+ *       -o quad_timer_bench
+ *   ./quad_timer_bench [quarters]
+ *
+ * The model's timer clock runs at 64 MHz of simulated time. The encoder
+ * pins follow the decoder's Gray sequence, holding each code for a
+ * random number of clocks. Runs of random length in either direction
+ * carry the 16-bit counter through many wraps, and short glitches are
+ * injected that the input filter should reject. The position is read at
+ * random intervals of up to 30000 quarter-steps and checked every time.
+ * Then: steps read after every quarter-step against Rotary's state table,
+ * direction with setReverse(), the read interval limit,
+ * readVelocity() at constant speeds, and glitches with the filter off.
+ */
+
+#include <stdio.h>
+#include "Arduino.h"
+#include "rotary.h"
+#include "rotary_quad_timer.h"
+#include "quad_timer_model.h"
+
+#define CLOCK_MHZ 64
+
+#ifdef HALF_STEP
+#define QUARTERS_PER_STEP 2
+#else
+#define QUARTERS_PER_STEP 4
+#endif
+
+// Clockwise Gray sequence as (pin2 << 1) | pin1.
+static const unsigned char sequence[4] = {0, 2, 3, 1};
+
+static unsigned long long seed = 1;
+
+static unsigned long randomNumber(unsigned long range) {
+  seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+  return (seed >> 33) % range;
+}
+
+// An encoder wired to a modelled timer, on a simulated clock.
+struct Rig {
+  QuadTimerModel model;
+  RotaryQuadTimer encoder = RotaryQuadTimer(&model.registers);
+  long quarter = 0;
+  unsigned long long clocks = 0;
+
+  // Starts the timer with the pins at rest.
+  void start() {
+    encoder.begin();
+    hold(16, sequence[quarter & 3]);
+  }
+
+  void hold(unsigned long count, unsigned char code) {
+    for (unsigned long i = 0; i < count; i++) {
+      model.clock(code & 1, code & 2);
+      clocks++;
+    }
+    hostSetMicros(clocks / CLOCK_MHZ);
+  }
+
+  // Moves one quarter-step, holding the new code for the given clocks.
+  void move(int direction, unsigned long count) {
+    quarter += direction;
+    hold(count, sequence[quarter & 3]);
+  }
+
+  // Flips one pin for a few clocks and back.
+  void glitch(unsigned long count) {
+    unsigned char code = sequence[quarter & 3];
+    hold(count, code ^ (1 + randomNumber(2)));
+    hold(1, code);
+  }
+};
+
+int main(int argc, char **argv) {
+  unsigned long total = argc > 1 ? atol(argv[1]) : 2000000;
+  bool ok = true;
+
+  // Random runs with glitches, filter 3: 8 clocks
+  Rig rig;
+  rig.encoder.setFilter(3);
+  rig.start();
+  unsigned long reads = 0, wrong = 0, wraps = 0;
+  long lowest = 0, highest = 0;
+  unsigned long sinceRead = 0, nextRead = 1;
+  int direction = 1;
+  unsigned long runLeft = 0;
+  for (unsigned long q = 0; q < total; q++) {
+    if (!runLeft) {
+      direction = randomNumber(2) ? 1 : -1;
+      runLeft = randomNumber(4) ? 1 + randomNumber(64) : 1 + randomNumber(200000);
+    }
+    runLeft--;
+    uint32_t counter = rig.model.registers.CNT;
+    rig.move(direction, 10 + randomNumber(30));
+    if (rig.model.registers.CNT + counter == 0xffff && (counter == 0 || counter == 0xffff)) {
+      wraps++;
+    }
+    if (!randomNumber(16)) {
+      rig.glitch(1 + randomNumber(6));
+    }
+    if (rig.quarter < lowest) {
+      lowest = rig.quarter;
+    }
+    if (rig.quarter > highest) {
+      highest = rig.quarter;
+    }
+    if (++sinceRead == nextRead) {
+      reads++;
+      long position = rig.encoder.readPosition();
+      long quarters = rig.encoder.readQuarters();
+      // On a detent the position is exact, between two it is one of them
+      long below = rig.quarter >= 0 ? rig.quarter / QUARTERS_PER_STEP
+                                     : -((-rig.quarter + QUARTERS_PER_STEP - 1) / QUARTERS_PER_STEP);
+      bool between = rig.quarter % QUARTERS_PER_STEP;
+      if (quarters != rig.quarter || (position != below && !(between && position == below + 1))) {
+        wrong++;
+      }
+      sinceRead = 0;
+      nextRead = 1 + randomNumber(30000);
+    }
+  }
+  bool good = !wrong && rig.encoder.readQuarters() == rig.quarter &&
+              rig.model.counted == total;
+  ok &= good;
+  printf("%lu quarter-steps from %ld to %ld, %lu counter wraps, %lu glitches rejected\n", total,
+         lowest, highest, wraps, rig.model.filtered);
+  printf("%lu reads, %lu wrong, %lu edges counted   %s\n\n", reads, wrong, rig.model.counted,
+         good ? "PASS" : "FAIL");
+
+  // Steps read after every quarter-step, against the state table fed the
+  // same codes
+  Rig walk;
+  walk.start();
+  Rotary decoder = Rotary(0, 1);
+  unsigned long differ = 0;
+  for (unsigned long q = 0; q < 200000; q++) {
+    walk.move(randomNumber(3) ? 1 : -1, 4);
+    decoder.process(sequence[walk.quarter & 3]);
+    if (walk.encoder.readPosition() != decoder.readPosition()) {
+      differ++;
+    }
+  }
+  good = !differ;
+  ok &= good;
+  printf("200000 quarter-steps read one by one: %lu differ from the state table   %s\n\n",
+         differ, good ? "PASS" : "FAIL");
+
+  // Direction, as Rotary counts it, and reversed
+  for (unsigned char reversed = 0; reversed < 2; reversed++) {
+    Rig turn;
+    turn.encoder.setReverse(reversed);
+    turn.start();
+    for (unsigned char i = 0; i < 4 * QUARTERS_PER_STEP; i++) {
+      turn.move(1, 4);
+    }
+    long position = turn.encoder.readPosition();
+    good = position == (reversed ? -4 : 4);
+    ok &= good;
+    printf("4 steps clockwise%s: position %ld   %s\n", reversed ? ", reversed" : "", position,
+           good ? "PASS" : "FAIL");
+  }
+
+  // Moves between reads just inside and outside the limit
+  static const long gaps[] = {32767, -32767, 32769};
+  for (unsigned char g = 0; g < 3; g++) {
+    Rig jump;
+    jump.start();
+    for (long i = 0; i < labs(gaps[g]); i++) {
+      jump.move(gaps[g] > 0 ? 1 : -1, 1);
+    }
+    long quarters = jump.encoder.readQuarters();
+    good = (quarters == gaps[g]) == (labs(gaps[g]) <= 32767);
+    ok &= good;
+    printf("%6ld quarter-steps between reads: read %6ld   %s\n", gaps[g], quarters,
+           good ? "PASS" : "FAIL");
+  }
+  printf("\n");
+
+  // Velocity at constant speeds, read every millisecond
+  static const long speeds[] = {1000, -20000, 400000};
+  for (unsigned char s = 0; s < 3; s++) {
+    Rig spin;
+    spin.start();
+    unsigned long period = CLOCK_MHZ * 1000000UL / labs(speeds[s]);
+    unsigned long long nextRead = CLOCK_MHZ * 1000;
+    for (unsigned long i = 0; i < (unsigned long)labs(speeds[s]) / 5; i++) {
+      spin.move(speeds[s] > 0 ? 1 : -1, period);
+      if (spin.clocks >= nextRead) {
+        spin.encoder.readVelocity();
+        nextRead += CLOCK_MHZ * 1000;
+      }
+    }
+    long velocity = spin.encoder.readVelocity();
+    good = labs(velocity - speeds[s]) <= labs(speeds[s]) / 100;
+    ok &= good;
+    printf("%7ld quarter-steps/s: readVelocity() %7ld   %s\n", speeds[s], velocity,
+           good ? "PASS" : "FAIL");
+  }
+  printf("\n");
+
+  // Glitches with and without the filter
+  for (unsigned char filter = 0; filter < 4; filter += 3) {
+    Rig noisy;
+    noisy.encoder.setFilter(filter);
+    noisy.start();
+    for (unsigned long i = 0; i < 100000; i++) {
+      noisy.move(1, 20);
+      noisy.glitch(3);
+      if (i % 1000 == 0) {
+        noisy.encoder.service();
+      }
+    }
+    long quarters = noisy.encoder.readQuarters();
+    good = quarters == noisy.quarter;
+    ok &= good;
+    printf("filter %u: 100000 quarter-steps, 100000 glitches: %lu edges counted, read %ld   %s\n",
+           filter, noisy.model.counted, quarters, good ? "PASS" : "FAIL");
+  }
+
+  printf("\nresult %s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,136 @@
+/*
+ * Register-level model of a 16-bit STM32-style timer in encoder mode, for
+ * running RotaryQuadTimer on a host:
+ *
+ *   QuadTimerModel model;
+ *   RotaryQuadTimer encoder = RotaryQuadTimer(&model.registers);
+ *   encoder.begin();
+ *   model.clock(pin1, pin2);   // once per timer clock
+ *
+ * The code under test reads and writes the register block as it would
+ * the real one. clock() plays one cycle of the timer's clock: it applies
+ * a pending update event, passes each input through its polarity and
+ * ICxF filter, and counts the filtered edges the way the selected SMS
+ * encoder mode does. Only channels configured as direct inputs (CCxS = 1)
+ * reach the counter, and nothing counts until CEN is set. The counter
+ * wraps between 0 and ARR, setting UIF and DIR as the hardware does. The
+ * prescaler is not modelled.
+ */
+
+#ifndef quad_timer_model_h
+#define quad_timer_model_h
+
+#include <string.h>
+#include "rotary_quad_timer.h"
+
+class QuadTimerModel
+{
+  public:
+    RotaryQuadTimerRegisters registers;
+    // Edges that reached the counter, and input changes the filters
+    // rejected as too short
+    unsigned long counted;
+    unsigned long filtered;
+
+    QuadTimerModel() {
+      memset((void *)&registers, 0, sizeof(registers));
+      registers.ARR = 0xffff;
+      counted = 0;
+      filtered = 0;
+      running = false;
+      for (unsigned char i = 0; i < 2; i++) {
+        level[i] = false;
+        steady[i] = 0;
+      }
+    }
+
+    // One cycle of the timer clock with the given levels on inputs 1 and 2.
+    void clock(bool in1, bool in2) {
+      if (registers.EGR & ROTARY_QT_EGR_UG) {
+        registers.EGR = 0;
+        registers.CNT = 0;
+        registers.SR |= ROTARY_QT_SR_UIF;
+      }
+      bool in[2] = {in1, in2};
+      const uint32_t polarity[2] = {ROTARY_QT_CCER_CC1P, ROTARY_QT_CCER_CC2P};
+      const unsigned char shift[2] = {0, 8};
+      bool enabled = registers.CR1 & ROTARY_QT_CR1_CEN;
+      for (unsigned char i = 0; i < 2; i++) {
+        bool input = in[i] != ((registers.CCER & polarity[i]) != 0);
+        uint32_t ccmr = registers.CCMR1 >> shift[i];
+        if (enabled && !running) {
+          // Setting up takes a few clocks on the real timer, enough for
+          // the inputs to settle before the counter starts
+          level[i] = input;
+          steady[i] = 0;
+        }
+        if (input == level[i]) {
+          if (steady[i]) {
+            filtered++;
+          }
+          steady[i] = 0;
+          continue;
+        }
+        // The new level has to hold for the filter's length first
+        if (++steady[i] < filterClocks((ccmr >> 4) & 0x0f)) {
+          continue;
+        }
+        steady[i] = 0;
+        level[i] = input;
+        if ((ccmr & 3) != ROTARY_QT_INPUT_DIRECT || !enabled) {
+          continue;
+        }
+        unsigned char mode = registers.SMCR & ROTARY_QT_SMCR_SMS;
+        if (i == 0 && (mode == 1 || mode == 3)) {
+          count(level[0] != level[1]);
+        }
+        else if (i == 1 && (mode == 2 || mode == 3)) {
+          count(level[1] == level[0]);
+        }
+      }
+      running = enabled;
+    }
+
+  private:
+    bool level[2];
+    unsigned int steady[2];
+    bool running;
+
+    // Timer clocks an input must hold for, for each ICxF value: N samples
+    // at the sampling clock fCK_INT or fDTS / d, with fDTS = fCK_INT.
+    static unsigned int filterClocks(unsigned char value) {
+      static const unsigned char samples[16] = {1, 2, 4, 8, 6, 8, 6, 8,
+                                                6, 8, 5, 6, 8, 5, 6, 8};
+      static const unsigned char divide[16] = {1, 1, 1, 1, 2, 2, 4, 4,
+                                               8, 8, 16, 16, 16, 32, 32, 32};
+      return samples[value] * divide[value];
+    }
+
+    void count(bool up) {
+      counted++;
+      uint32_t counter = registers.CNT & 0xffff;
+      if (up) {
+        registers.CR1 &= ~ROTARY_QT_CR1_DIR;
+        if (counter >= registers.ARR) {
+          counter = 0;
+          registers.SR |= ROTARY_QT_SR_UIF;
+        }
+        else {
+          counter++;
+        }
+      }
+      else {
+        registers.CR1 |= ROTARY_QT_CR1_DIR;
+        if (counter == 0) {
+          counter = registers.ARR;
+          registers.SR |= ROTARY_QT_SR_UIF;
+        }
+        else {
+          counter--;
+        }
+      }
+      registers.CNT = counter;
+    }
+};
+
+#endif
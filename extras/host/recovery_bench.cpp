@@ -0,0 +1,88 @@
+/*
+ * Steps lost to slow sampling, with and without setRecovery().
+ *
+ *   g++ -std=c++17 -O2 -pthread -I extras/host -I . rotary.cpp \
+ *       extras/host/recovery_bench.cpp -o recovery_bench
+ *   ./recovery_bench [samplePeriodMicros] [jitterPercent]
+ *
+ * An encoder turning clockwise at a steady speed is sampled every
+ * samplePeriodMicros, give or take jitterPercent of the period, on a
+ * simulated clock, and each sample is fed to two decoders, one with
+ * recovery on. The speed goes up in steps, given as quarter-steps (pin
+ * transitions) per sample period. Above 1 some samples see two
+ * transitions at once, which plain decoding discards and recovery
+ * restores. Once a sample can see three, it looks like one transition
+ * backwards to either decoder.
+ */
+
+#include <stdio.h>
+#include "Arduino.h"
+#include "rotary.h"
+
+#define SAMPLES 100000
+#define DETENTS 24
+
+// Clockwise Gray sequence as (pin2 << 1) | pin1, from rest on 00.
+static const unsigned char cwSequence[4] = {0, 2, 3, 1};
+
+static const double speeds[] = {0.5, 0.9, 1.1, 1.3, 1.5, 1.7, 1.8, 1.9, 2.1};
+
+static unsigned long long seed = 1;
+
+static unsigned long randomNumber(unsigned long range) {
+  seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+  return (seed >> 33) % range;
+}
+
+int main(int argc, char **argv) {
+  unsigned long period = argc > 1 ? atol(argv[1]) : 200;
+  unsigned long jitter = argc > 2 ? atol(argv[2]) : 10;
+  unsigned long spread = 2 * period * jitter / 100;
+
+  printf("sample period %lu us +/- %lu%%, %d samples per speed\n\n", period, jitter, SAMPLES);
+  printf("quarters/sample  rpm (%d det)  expected     plain  recovered  inferred\n", DETENTS);
+  bool ok = true;
+  for (unsigned char s = 0; s < sizeof(speeds) / sizeof(speeds[0]); s++) {
+    Rotary plain(2, 3);
+    Rotary recovering(4, 5);
+    recovering.setRecovery(true);
+    double rate = speeds[s] / period;
+    unsigned long now = 0;
+    unsigned long quarters = 0;
+    unsigned long widest = 0;
+    for (unsigned long i = 0; i < SAMPLES; i++) {
+      unsigned long step = period - spread / 2 + (spread ? randomNumber(spread + 1) : 0);
+      now += step;
+      hostSetMicros(now);
+      unsigned long reached = (unsigned long)(now * rate);
+      if (reached - quarters > widest) {
+        widest = reached - quarters;
+      }
+      quarters = reached;
+      unsigned char pins = cwSequence[quarters & 3];
+      plain.process(pins);
+      recovering.process(pins);
+    }
+    // Let the encoder come to rest so both finish on a whole step
+    while (quarters & 3) {
+      quarters++;
+      plain.process(cwSequence[quarters & 3]);
+      recovering.process(cwSequence[quarters & 3]);
+    }
+#ifdef HALF_STEP
+    long expected = quarters / 2;
+#else
+    long expected = quarters / 4;
+#endif
+    double rpm = speeds[s] * 1e6 / period / 4 / DETENTS * 60;
+    printf("%15.1f  %12.0f  %8ld  %8ld  %9ld  %8u\n", speeds[s], rpm, expected,
+           plain.readPosition(), recovering.readPosition(), recovering.inferredCount());
+    // As long as no sample saw three transitions, recovery loses nothing,
+    // apart from a jump before the first transition gave the direction
+    if (widest < 3 && labs(recovering.readPosition() - expected) > 1) {
+      ok = false;
+    }
+  }
+  printf("\nresult %s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
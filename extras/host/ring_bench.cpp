@@ -0,0 +1,137 @@
+/*
+ * Host check of RotaryEventRing with several consumers.
+ *
+ *   g++ -std=c++17 -O2 -pthread -I extras/host -I . rotary_ring.cpp \
+ *       extras/host/ring_bench.cpp -o ring_bench
+ *   ./ring_bench [events]
+ *
+ * A producer thread pushes numbered events in bursts, as an encoder
+ * interrupt would, while three consumer threads read them at different
+ * paces: a UI that reads continuously, a logger that reads every 50 µs
+ * and a network reporter that reads every 2 ms and so falls behind. Each
+ * consumer checks that its events arrive in order and intact, and that
+ * the gaps it sees are exactly the events its reader counts as lost.
+ *
+ * Then it times the producer's side: one push into the ring, against a
+ * push into each of three separate queues.
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <thread>
+#include "Arduino.h"
+#include "rotary_ring.h"
+
+#define CONSUMERS 3
+
+static double seconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Event n carries n in its time and values derived from n in the other
+// fields, so that a torn copy shows up.
+static RotaryEvent numbered(unsigned long n) {
+  RotaryEvent event = {n, (unsigned char)(n * 7), (unsigned char)(n >> 8 ^ 0x5a)};
+  return event;
+}
+
+struct Consumer {
+  const char *name;
+  unsigned long pause;
+  unsigned long received;
+  unsigned long gaps;
+  unsigned long torn;
+  unsigned long lost;
+  bool ordered;
+};
+
+static std::atomic<bool> producing(true);
+
+static void consume(RotaryEventRing &ring, Consumer &consumer) {
+  RotaryRingReader reader(ring);
+  unsigned long expected = 0;
+  for (;;) {
+    bool done = !producing.load();
+    RotaryEvent event;
+    while (reader.read(event)) {
+      RotaryEvent check = numbered(event.time);
+      if (event.source != check.source || event.event != check.event) {
+        consumer.torn++;
+      }
+      if (event.time < expected) {
+        consumer.ordered = false;
+      }
+      consumer.gaps += event.time - expected;
+      expected = event.time + 1;
+      consumer.received++;
+    }
+    if (done) {
+      break;
+    }
+    if (consumer.pause) {
+      std::this_thread::sleep_for(std::chrono::microseconds(consumer.pause));
+    }
+  }
+  consumer.lost = reader.lost();
+}
+
+int main(int argc, char **argv) {
+  unsigned long total = argc > 1 ? atol(argv[1]) : 200000;
+  static RotaryEventRing ring;
+  Consumer consumers[CONSUMERS] = {
+    {"ui", 0, 0, 0, 0, 0, true},
+    {"logger", 50, 0, 0, 0, 0, true},
+    {"network", 2000, 0, 0, 0, 0, true},
+  };
+  std::thread threads[CONSUMERS];
+  for (unsigned char i = 0; i < CONSUMERS; i++) {
+    threads[i] = std::thread(consume, std::ref(ring), std::ref(consumers[i]));
+  }
+  // Let every reader start at event 0
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  for (unsigned long n = 0; n < total; n++) {
+    ring.push(numbered(n));
+    if (n % 8 == 7) {
+      // A burst of steps, then a pause
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  }
+  producing = false;
+  for (unsigned char i = 0; i < CONSUMERS; i++) {
+    threads[i].join();
+  }
+
+  bool ok = ring.pushed() == total;
+  printf("%lu events pushed, ring of %d\n\n", total, ROTARY_RING_SIZE);
+  printf("%-10s %10s %10s %10s %6s\n", "consumer", "received", "lost", "gaps", "torn");
+  for (unsigned char i = 0; i < CONSUMERS; i++) {
+    Consumer &c = consumers[i];
+    bool good = c.ordered && !c.torn && c.gaps == c.lost && c.received + c.lost == total;
+    printf("%-10s %10lu %10lu %10lu %6lu   %s\n", c.name, c.received, c.lost, c.gaps, c.torn,
+           good ? "PASS" : "FAIL");
+    ok &= good;
+  }
+
+  // Producer cost, with no readers running
+  const unsigned long rounds = 50000000;
+  static RotaryEventRing queues[CONSUMERS];
+  double start = seconds();
+  for (unsigned long n = 0; n < rounds; n++) {
+    ring.push(numbered(n));
+  }
+  double broadcast = (seconds() - start) * 1e9 / rounds;
+  start = seconds();
+  for (unsigned long n = 0; n < rounds; n++) {
+    RotaryEvent event = numbered(n);
+    for (unsigned char i = 0; i < CONSUMERS; i++) {
+      queues[i].push(event);
+    }
+  }
+  double copies = (seconds() - start) * 1e9 / rounds;
+  printf("\nproducer, broadcast ring        %.2f ns per event\n", broadcast);
+  printf("producer, %d separate queues     %.2f ns per event\n", CONSUMERS, copies);
+  printf("\nresult %s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,507 @@
+/*
+ * Replay of recorded encoder captures on a desktop host.
+ *
+ * Index file layout, all integers little-endian:
+ *
+ *   0   "RIDX"
+ *   4   version (1)
+ *   5   1 if built with HALF_STEP, else 0
+ *   8   interval, 4 bytes
+ *   12  capture length in samples, 8 bytes
+ *   20  number of checkpoints, 8 bytes
+ *   28  reserved, 4 bytes
+ *   32  checkpoints, 12 bytes each: position (8), state, button, 2 reserved
+ *
+ * Checkpoint k holds the decoder as it was before sample k * interval. An
+ * index whose capture length or step mode does not match is stale and is
+ * not loaded.
+ */
+
+#include "Arduino.h"
+#include "rotary_capture.h"
+
+#define INDEX_HEADER 32
+#define INDEX_ENTRY 12
+#define INDEX_VERSION 1
+#define REPLAY_CHUNK 65536
+
+#ifdef HALF_STEP
+#define INDEX_HALF_STEP 1
+#else
+#define INDEX_HALF_STEP 0
+#endif
+
+static void putLittle(unsigned char *bytes, unsigned long long value, unsigned char size) {
+  for (unsigned char i = 0; i < size; i++) {
+    bytes[i] = value >> (8 * i);
+  }
+}
+
+static unsigned long long getLittle(const unsigned char *bytes, unsigned char size) {
+  unsigned long long value = 0;
+  for (unsigned char i = 0; i < size; i++) {
+    value |= (unsigned long long)bytes[i] << (8 * i);
+  }
+  return value;
+}
+
+RotaryReplay::RotaryReplay() : decoder(0, 1) {
+  file = 0;
+  total = 0;
+  current = 0;
+  interval = 0;
+  buttonLevel = HIGH;
+  buffer.resize(REPLAY_CHUNK);
+  // The decoder as constructed, before any sample
+  save(origin);
+}
+
+RotaryReplay::~RotaryReplay() {
+  close();
+}
+
+/*
+ * Opens a raw capture and positions the decoder before its first sample.
+ * The index is not loaded; call loadIndex() or buildIndex().
+ */
+bool RotaryReplay::open(const char *path) {
+  close();
+  file = fopen(path, "rb");
+  if (!file) {
+    return false;
+  }
+  fseeko(file, 0, SEEK_END);
+  total = ftello(file);
+  indexPath = std::string(path) + ".idx";
+  restart();
+  return true;
+}
+
+void RotaryReplay::close() {
+  if (file) {
+    fclose(file);
+    file = 0;
+  }
+  index.clear();
+  interval = 0;
+}
+
+unsigned long long RotaryReplay::samples() {
+  return total;
+}
+
+void RotaryReplay::restart() {
+  restore(origin);
+  current = 0;
+  fseeko(file, 0, SEEK_SET);
+}
+
+void RotaryReplay::save(RotaryCheckpoint &checkpoint) {
+  checkpoint.position = decoder.readPosition();
+  checkpoint.state = decoder.readState();
+  checkpoint.button = buttonLevel;
+}
+
+void RotaryReplay::restore(const RotaryCheckpoint &checkpoint) {
+  decoder.restoreState(checkpoint.state, checkpoint.position);
+  buttonLevel = checkpoint.button;
+}
+
+/*
+ * Decodes the whole capture once, keeping a checkpoint every interval
+ * samples, and writes them to <capture>.idx. The new index is loaded.
+ * Returns false if the index file cannot be written.
+ */
+bool RotaryReplay::buildIndex(unsigned long every) {
+  if (!file || !every) {
+    return false;
+  }
+  index.clear();
+  interval = every;
+  restart();
+  RotaryCheckpoint checkpoint;
+  do {
+    save(checkpoint);
+    index.push_back(checkpoint);
+  } while (decode(interval, 0, 0) == interval && current < total);
+
+  FILE *out = fopen(indexPath.c_str(), "wb");
+  if (!out) {
+    index.clear();
+    return false;
+  }
+  unsigned char header[INDEX_HEADER] = {'R', 'I', 'D', 'X', INDEX_VERSION, INDEX_HALF_STEP};
+  putLittle(header + 8, interval, 4);
+  putLittle(header + 12, total, 8);
+  putLittle(header + 20, index.size(), 8);
+  bool ok = fwrite(header, 1, INDEX_HEADER, out) == INDEX_HEADER;
+  for (size_t k = 0; ok && k < index.size(); k++) {
+    unsigned char entry[INDEX_ENTRY] = {0};
+    putLittle(entry, (unsigned long long)index[k].position, 8);
+    entry[8] = index[k].state;
+    entry[9] = index[k].button;
+    ok = fwrite(entry, 1, INDEX_ENTRY, out) == INDEX_ENTRY;
+  }
+  ok = fclose(out) == 0 && ok;
+  if (!ok) {
+    index.clear();
+    remove(indexPath.c_str());
+  }
+  return ok;
+}
+
+/*
+ * Loads <capture>.idx. Returns false, and leaves seek() decoding from the
+ * start, if there is no index or it does not belong to this capture.
+ */
+bool RotaryReplay::loadIndex() {
+  index.clear();
+  FILE *in = fopen(indexPath.c_str(), "rb");
+  if (!in) {
+    return false;
+  }
+  unsigned char header[INDEX_HEADER];
+  bool ok = fread(header, 1, INDEX_HEADER, in) == INDEX_HEADER &&
+            memcmp(header, "RIDX", 4) == 0 && header[4] == INDEX_VERSION &&
+            header[5] == INDEX_HALF_STEP && getLittle(header + 12, 8) == total;
+  unsigned long long count = ok ? getLittle(header + 20, 8) : 0;
+  interval = ok ? getLittle(header + 8, 4) : 0;
+  ok = ok && interval && count == total / interval + (total % interval || !total ? 1 : 0);
+  for (unsigned long long k = 0; ok && k < count; k++) {
+    unsigned char entry[INDEX_ENTRY];
+    ok = fread(entry, 1, INDEX_ENTRY, in) == INDEX_ENTRY;
+    RotaryCheckpoint checkpoint;
+    checkpoint.position = (long)getLittle(entry, 8);
+    checkpoint.state = entry[8];
+    checkpoint.button = entry[9];
+    index.push_back(checkpoint);
+  }
+  fclose(in);
+  if (!ok) {
+    index.clear();
+    interval = 0;
+  }
+  return ok;
+}
+
+unsigned long RotaryReplay::checkpoints() {
+  return index.size();
+}
+
+/*
+ * Positions the decoder before the given sample, as if every sample
+ * before it had been decoded. Uses the nearest checkpoint at or before
+ * the sample when an index is loaded. Returns false past the end.
+ */
+bool RotaryReplay::seek(unsigned long long sample) {
+  if (!file || sample > total) {
+    return false;
+  }
+  if (index.empty()) {
+    if (sample < current) {
+      restart();
+    }
+  }
+  else {
+    unsigned long long k = sample / interval;
+    if (k >= index.size()) {
+      k = index.size() - 1;
+    }
+    // Carry on from the current sample if it is between the checkpoint
+    // and the target
+    if (k * interval > current || sample < current) {
+      restore(index[k]);
+      current = k * interval;
+      fseeko(file, current, SEEK_SET);
+    }
+  }
+  unsigned long long remaining = sample - current;
+  return decode(remaining, 0, 0) == remaining;
+}
+
+/*
+ * Decodes up to count samples from the current one, calling back for each
+ * step. Returns the number of samples decoded, less than count at the end
+ * of the capture.
+ */
+unsigned long long RotaryReplay::decode(unsigned long long count, Callback callback, void *context) {
+  unsigned char *chunk = buffer.data();
+  unsigned long long done = 0;
+  while (done < count) {
+    size_t want = count - done < REPLAY_CHUNK ? count - done : REPLAY_CHUNK;
+    size_t got = fread(chunk, 1, want, file);
+    for (size_t i = 0; i < got; i++) {
+      unsigned char result = decoder.process(chunk[i] & ROTARY_CAPTURE_PINS);
+      if (result && callback) {
+        callback(context, current + i, result);
+      }
+    }
+    if (got) {
+      buttonLevel = chunk[got - 1] & ROTARY_CAPTURE_BUTTON ? HIGH : LOW;
+    }
+    current += got;
+    done += got;
+    if (got < want) {
+      break;
+    }
+  }
+  return done;
+}
+
+/*
+ * Number of the next sample to be decoded.
+ */
+unsigned long long RotaryReplay::tell() {
+  return current;
+}
+
+long RotaryReplay::position() {
+  return decoder.readPosition();
+}
+
+/*
+ * Button level (HIGH when open) at the last sample decoded.
+ */
+unsigned char RotaryReplay::button() {
+  return buttonLevel;
+}
+
+/*
+ * Transition capture layout, integers little-endian:
+ *
+ *   0   "RTCP"
+ *   4   version (1)
+ *   5   levels at sample 0, in the raw sample bits
+ *   8   sample period in picoseconds, 8 bytes, 0 if unknown
+ *   16  length in samples, 8 bytes
+ *   24  transitions, each a varint (7 bits a byte, low bits first) of
+ *       (samples since the previous transition << 3) | new levels
+ *
+ * Decoding does not expand the runs between transitions. The state table
+ * settles within two identical samples (see extras/host/ttverify), so
+ * applying the levels of a run twice, or once for a run of one sample,
+ * leaves the decoder exactly where every sample of the run would, and
+ * emits the same steps at the same samples.
+ */
+
+#define TRANSITION_HEADER 24
+#define TRANSITION_VERSION 1
+
+RotaryTransitionReader::RotaryTransitionReader() : decoder(0, 1) {
+  file = 0;
+  total = 0;
+  tick = 0;
+  changes = 0;
+  initial = 0;
+  rest = decoder.readState();
+  buttonLevel = HIGH;
+}
+
+RotaryTransitionReader::~RotaryTransitionReader() {
+  close();
+}
+
+/*
+ * Opens a transition capture. Returns false if it is not one.
+ */
+bool RotaryTransitionReader::open(const char *path) {
+  close();
+  file = fopen(path, "rb");
+  if (!file) {
+    return false;
+  }
+  unsigned char header[TRANSITION_HEADER];
+  if (fread(header, 1, TRANSITION_HEADER, file) != TRANSITION_HEADER ||
+      memcmp(header, "RTCP", 4) != 0 || header[4] != TRANSITION_VERSION) {
+    close();
+    return false;
+  }
+  initial = header[5] & ROTARY_CAPTURE_LEVELS;
+  tick = getLittle(header + 8, 8);
+  total = getLittle(header + 16, 8);
+  return true;
+}
+
+void RotaryTransitionReader::close() {
+  if (file) {
+    fclose(file);
+    file = 0;
+  }
+}
+
+unsigned long long RotaryTransitionReader::samples() {
+  return total;
+}
+
+/*
+ * Transitions read by the last decode().
+ */
+unsigned long long RotaryTransitionReader::transitions() {
+  return changes;
+}
+
+unsigned long long RotaryTransitionReader::tickPicos() {
+  return tick;
+}
+
+/*
+ * Reads the next transition. Returns 1 if there was one, 0 at the end of
+ * the file, and -1 if the file ends in the middle of one or its varint is
+ * too long to be valid.
+ */
+int RotaryTransitionReader::next(unsigned long long &delta, unsigned char &levels) {
+  unsigned long long value = 0;
+  int c;
+  for (unsigned char shift = 0; shift < 64; shift += 7) {
+    if ((c = getc_unlocked(file)) == EOF) {
+      return shift ? -1 : 0;
+    }
+    value |= (unsigned long long)(c & 0x7f) << shift;
+    if (!(c & 0x80)) {
+      delta = value >> 3;
+      levels = value & ROTARY_CAPTURE_LEVELS;
+      return 1;
+    }
+  }
+  return -1;
+}
+
+/*
+ * Decodes the whole capture from the start, calling back for each step
+ * with the sample it happened at. Returns false if the capture ends in the
+ * middle of a transition or is inconsistent with its length. A capture
+ * cut exactly between two transitions cannot be told from a complete one,
+ * as its last run then lasts to the length given in the header.
+ */
+bool RotaryTransitionReader::decode(Callback callback, void *context) {
+  if (!file) {
+    return false;
+  }
+  fseeko(file, TRANSITION_HEADER, SEEK_SET);
+  decoder.restoreState(rest, 0);
+  changes = 0;
+  unsigned char levels = initial;
+  unsigned long long at = 0;
+  bool ok = true;
+  while (at < total) {
+    unsigned long long delta;
+    unsigned char following;
+    int read = next(delta, following);
+    if (read > 0) {
+      changes++;
+      if (!delta || at + delta > total) {
+        ok = false;
+        break;
+      }
+    }
+    else if (read < 0) {
+      ok = false;
+      break;
+    }
+    else {
+      // The last run lasts to the end of the capture
+      delta = total - at;
+    }
+    unsigned char repeats = delta < 2 ? 1 : 2;
+    for (unsigned char i = 0; i < repeats; i++) {
+      unsigned char result = decoder.process(levels & ROTARY_CAPTURE_PINS);
+      if (result && callback) {
+        callback(context, at + i, result);
+      }
+    }
+    buttonLevel = levels & ROTARY_CAPTURE_BUTTON ? HIGH : LOW;
+    at += delta;
+    levels = following;
+  }
+  return ok;
+}
+
+long RotaryTransitionReader::position() {
+  return decoder.readPosition();
+}
+
+/*
+ * Button level (HIGH when open) at the end of the capture.
+ */
+unsigned char RotaryTransitionReader::button() {
+  return buttonLevel;
+}
+
+RotaryTransitionWriter::RotaryTransitionWriter() {
+  file = 0;
+  last = 0;
+  levels = 0;
+  changes = 0;
+}
+
+RotaryTransitionWriter::~RotaryTransitionWriter() {
+  if (file) {
+    fclose(file);
+  }
+}
+
+/*
+ * Creates a transition capture, with the levels at sample 0 and the
+ * sample period in picoseconds (0 if not known).
+ */
+bool RotaryTransitionWriter::open(const char *path, unsigned char initial, unsigned long long tickPicos) {
+  file = fopen(path, "wb");
+  if (!file) {
+    return false;
+  }
+  unsigned char header[TRANSITION_HEADER] = {'R', 'T', 'C', 'P', TRANSITION_VERSION};
+  header[5] = initial & ROTARY_CAPTURE_LEVELS;
+  putLittle(header + 8, tickPicos, 8);
+  last = 0;
+  levels = header[5];
+  changes = 0;
+  return fwrite(header, 1, TRANSITION_HEADER, file) == TRANSITION_HEADER;
+}
+
+/*
+ * Records the levels from the given sample on. Samples must come in
+ * order; levels equal to the current ones are not stored. Returns false
+ * on a write error or a sample out of order.
+ */
+bool RotaryTransitionWriter::add(unsigned long long sample, unsigned char sampleLevels) {
+  sampleLevels &= ROTARY_CAPTURE_LEVELS;
+  if (sampleLevels == levels) {
+    return true;
+  }
+  if (sample <= last) {
+    return false;
+  }
+  unsigned long long value = (sample - last) << 3 | sampleLevels;
+  do {
+    unsigned char byte = value & 0x7f;
+    value >>= 7;
+    if (putc_unlocked(value ? byte | 0x80 : byte, file) == EOF) {
+      return false;
+    }
+  } while (value);
+  last = sample;
+  levels = sampleLevels;
+  changes++;
+  return true;
+}
+
+/*
+ * Writes the capture length, which must be past the last transition, and
+ * closes the file.
+ */
+bool RotaryTransitionWriter::close(unsigned long long samples) {
+  if (!file) {
+    return false;
+  }
+  unsigned char length[8];
+  putLittle(length, samples, 8);
+  bool ok = (samples > last || !changes) && fseeko(file, 16, SEEK_SET) == 0 &&
+            fwrite(length, 1, 8, file) == 8;
+  ok = fclose(file) == 0 && ok;
+  file = 0;
+  return ok;
+}
+
+unsigned long long RotaryTransitionWriter::transitions() {
+  return changes;
+}
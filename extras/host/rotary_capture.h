@@ -0,0 +1,127 @@
+/*
+ * Replay of recorded encoder captures on a desktop host.
+ *
+ * A raw capture is one byte per sample, taken at a fixed rate, with no
+ * header: bit 0 is the level of pin 1, bit 1 of pin 2 and bit 2 of the
+ * button. RotaryReplay decodes it through the same state table as the
+ * library. So that a point an hour into a large capture can be inspected
+ * without decoding everything before it, buildIndex() writes a checkpoint
+ * index next to the capture, in <capture>.idx, holding the decoder state,
+ * position and button level every interval samples. seek() then restores
+ * the nearest checkpoint at or before the target and decodes only the
+ * remaining samples, which gives exactly the results of decoding from the
+ * start.
+ *
+ * A transition capture stores only the samples where a level changed,
+ * each as a varint of the number of samples since the previous change
+ * and the new levels. Raw captures are mostly unchanged samples, so it is
+ * far smaller, and RotaryTransitionReader decodes it without expanding it
+ * back, in time proportional to the number of transitions.
+ */
+
+#ifndef rotary_capture_h
+#define rotary_capture_h
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "rotary.h"
+
+// Bits of a raw capture sample.
+#define ROTARY_CAPTURE_PINS 0x03
+#define ROTARY_CAPTURE_BUTTON 0x04
+#define ROTARY_CAPTURE_LEVELS 0x07
+
+// Default samples between index checkpoints.
+#define ROTARY_INDEX_INTERVAL 65536
+
+// Decoder state before a given sample.
+struct RotaryCheckpoint {
+  long position;
+  unsigned char state;
+  unsigned char button;
+};
+
+class RotaryReplay
+{
+  public:
+    // Called for every step decoded, with its sample number and direction.
+    typedef void (*Callback)(void *, unsigned long long, unsigned char);
+
+    RotaryReplay();
+    ~RotaryReplay();
+    bool open(const char *);
+    void close();
+    unsigned long long samples();
+    // Checkpoint index
+    bool buildIndex(unsigned long);
+    bool loadIndex();
+    unsigned long checkpoints();
+    // Decoding
+    bool seek(unsigned long long);
+    unsigned long long decode(unsigned long long, Callback, void *);
+    unsigned long long tell();
+    long position();
+    unsigned char button();
+  private:
+    void restart();
+    void save(RotaryCheckpoint &);
+    void restore(const RotaryCheckpoint &);
+    FILE *file;
+    RotaryCheckpoint origin;
+    std::string indexPath;
+    unsigned long long total;
+    unsigned long long current;
+    unsigned long interval;
+    std::vector<RotaryCheckpoint> index;
+    std::vector<unsigned char> buffer;
+    Rotary decoder;
+    unsigned char buttonLevel;
+};
+
+// Reads a transition capture and runs the state table on it directly.
+class RotaryTransitionReader
+{
+  public:
+    typedef RotaryReplay::Callback Callback;
+
+    RotaryTransitionReader();
+    ~RotaryTransitionReader();
+    bool open(const char *);
+    void close();
+    unsigned long long samples();
+    unsigned long long transitions();
+    unsigned long long tickPicos();
+    bool decode(Callback, void *);
+    long position();
+    unsigned char button();
+  private:
+    int next(unsigned long long &, unsigned char &);
+    FILE *file;
+    unsigned long long total;
+    unsigned long long tick;
+    unsigned long long changes;
+    unsigned char initial;
+    unsigned char rest;
+    Rotary decoder;
+    unsigned char buttonLevel;
+};
+
+// Writes a transition capture from samples given in order.
+class RotaryTransitionWriter
+{
+  public:
+    RotaryTransitionWriter();
+    ~RotaryTransitionWriter();
+    bool open(const char *, unsigned char, unsigned long long);
+    bool add(unsigned long long, unsigned char);
+    bool close(unsigned long long);
+    unsigned long long transitions();
+  private:
+    FILE *file;
+    unsigned long long last;
+    unsigned char levels;
+    unsigned long long changes;
+};
+
+#endif
@@ -0,0 +1,69 @@
+/*
+ * File-backed stand-in for journal storage on a desktop host. The file
+ * is created, or grown, to hold the requested number of blocks.
+ */
+
+#ifndef rotary_journal_file_h
+#define rotary_journal_file_h
+
+#include <stdio.h>
+#include "rotary_journal.h"
+
+class RotaryJournalFile : public RotaryJournalStorage
+{
+  public:
+    RotaryJournalFile() : file(0), count(0) {}
+    ~RotaryJournalFile() { close(); }
+
+    bool open(const char *path, unsigned long blocks) {
+      close();
+      file = fopen(path, "r+b");
+      if (!file) {
+        file = fopen(path, "w+b");
+      }
+      if (!file) {
+        return false;
+      }
+      fseek(file, 0, SEEK_END);
+      long size = ftell(file);
+      static const unsigned char blank[ROTARY_JOURNAL_BLOCK] = {0};
+      for (long at = size / ROTARY_JOURNAL_BLOCK; at < (long)blocks; at++) {
+        fseek(file, at * ROTARY_JOURNAL_BLOCK, SEEK_SET);
+        fwrite(blank, 1, ROTARY_JOURNAL_BLOCK, file);
+      }
+      fflush(file);
+      count = blocks;
+      writes = 0;
+      return true;
+    }
+
+    void close() {
+      if (file) {
+        fclose(file);
+        file = 0;
+      }
+    }
+
+    unsigned long blocks() { return count; }
+
+    bool readBlock(unsigned long block, unsigned char *data) {
+      return fseek(file, block * ROTARY_JOURNAL_BLOCK, SEEK_SET) == 0 &&
+             fread(data, 1, ROTARY_JOURNAL_BLOCK, file) == ROTARY_JOURNAL_BLOCK;
+    }
+
+    bool writeBlock(unsigned long block, const unsigned char *data) {
+      writes++;
+      return fseek(file, block * ROTARY_JOURNAL_BLOCK, SEEK_SET) == 0 &&
+             fwrite(data, 1, ROTARY_JOURNAL_BLOCK, file) == ROTARY_JOURNAL_BLOCK &&
+             fflush(file) == 0;
+    }
+
+    // Block writes since open()
+    unsigned long writes;
+
+  private:
+    FILE *file;
+    unsigned long count;
+};
+
+#endif
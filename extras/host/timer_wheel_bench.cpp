@@ -0,0 +1,187 @@
+/*
+ * Host check of RotaryTimerWheel, and the cost of a tick against polling
+ * every button's timer.
+ *
+ *   g++ -std=c++17 -O2 -pthread -I extras/host -I . rotary_timer.cpp \
+ *       extras/host/timer_wheel_bench.cpp -o timer_wheel_bench
+ *   ./timer_wheel_bench
+ *
+ * First schedules, moves and cancels timers at random, with delays well
+ * beyond the wheel's top level and with the time wrapping past 2^32, and
+ * checks that every timer fires exactly on its deadline and cancelled
+ * ones never do.
+ *
+ * Then compares two ways of keeping long-press deadlines for many
+ * buttons, where a few are held at any moment. Polling checks
+ * millis() - buttonTimer for every button on every tick, as the button
+ * methods do; the wheel only touches the timers that expire.
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <vector>
+#include "Arduino.h"
+#include "rotary_timer.h"
+
+static unsigned long long seed = 1;
+
+static unsigned long randomNumber(unsigned long range) {
+  seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+  return (seed >> 33) % range;
+}
+
+static double seconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+struct Checked {
+  RotaryTimerWheel *wheel;
+  RotaryTimer timer;
+  unsigned long expected;
+  unsigned long fired;
+  unsigned long early;
+  unsigned long late;
+};
+
+static void checkFire(void *context) {
+  Checked *checked = (Checked *)context;
+  unsigned long now = checked->wheel->now();
+  checked->fired++;
+  if (now != checked->expected) {
+    (now - checked->expected < 0x80000000UL ? checked->late : checked->early)++;
+  }
+}
+
+static bool correctness() {
+  const unsigned int timers = 2000;
+  RotaryTimerWheel wheel;
+  // Start just before the tick counter wraps
+  wheel.begin(0xffffffffUL - 30000);
+  std::vector<Checked> checks(timers);
+  unsigned long scheduled = 0;
+  unsigned long cancelled = 0;
+  for (unsigned int i = 0; i < timers; i++) {
+    checks[i].wheel = &wheel;
+    checks[i].timer.set(checkFire, &checks[i]);
+    checks[i].fired = checks[i].early = checks[i].late = 0;
+  }
+  unsigned long fired = 0;
+  for (unsigned long tick = 0; tick < 100000; tick++) {
+    for (unsigned char n = 0; n < 4; n++) {
+      Checked &c = checks[randomNumber(timers)];
+      unsigned long choice = randomNumber(10);
+      if (choice == 0) {
+        if (c.timer.scheduled()) {
+          cancelled++;
+        }
+        wheel.cancel(c.timer);
+      }
+      else {
+        // Mostly button-like delays, sometimes long ones
+        unsigned long delay = choice < 8 ? 1 + randomNumber(1000) : 1 + randomNumber(20000);
+        if (c.timer.scheduled()) {
+          cancelled++;
+        }
+        wheel.schedule(c.timer, delay);
+        c.expected = wheel.now() + delay;
+        scheduled++;
+      }
+    }
+    fired += wheel.advance(wheel.now() + 1);
+  }
+  // Let everything left run out
+  for (unsigned long tick = 0; tick < 30000; tick++) {
+    fired += wheel.advance(wheel.now() + 1);
+  }
+  unsigned long early = 0;
+  unsigned long late = 0;
+  unsigned long counted = 0;
+  for (unsigned int i = 0; i < timers; i++) {
+    early += checks[i].early;
+    late += checks[i].late;
+    counted += checks[i].fired;
+  }
+  bool ok = !early && !late && counted == fired && fired + cancelled == scheduled && !wheel.pending();
+  printf("scheduled %lu, moved or cancelled %lu, fired %lu, early %lu, late %lu: %s\n\n",
+         scheduled, cancelled, fired, early, late, ok ? "PASS" : "FAIL");
+  return ok;
+}
+
+// Polling: what each button method does on every call.
+struct PolledButton {
+  bool held;
+  unsigned long buttonTimer;
+};
+
+struct WheelButton {
+  RotaryTimer timer;
+  unsigned long *fired;
+};
+
+static void longPress(void *context) {
+  (*((WheelButton *)context)->fired)++;
+}
+
+// Presses random buttons for a long-press deadline of 600 ticks, at a
+// rate that keeps about 8 held at once, and returns the time per tick.
+static double pollTicks(unsigned int buttons, unsigned long ticks, unsigned long &fired) {
+  std::vector<PolledButton> polled(buttons);
+  for (unsigned int i = 0; i < buttons; i++) {
+    polled[i].held = false;
+  }
+  seed = 7;
+  double start = seconds();
+  for (unsigned long now = 1; now <= ticks; now++) {
+    for (unsigned int i = 0; i < buttons; i++) {
+      if (polled[i].held && now - polled[i].buttonTimer >= 600) {
+        polled[i].held = false;
+        fired++;
+      }
+    }
+    if (!randomNumber(75)) {
+      PolledButton &b = polled[randomNumber(buttons)];
+      b.held = true;
+      b.buttonTimer = now;
+    }
+  }
+  return (seconds() - start) * 1e9 / ticks;
+}
+
+static double wheelTicks(unsigned int buttons, unsigned long ticks, unsigned long &fired) {
+  std::vector<WheelButton> wheeled(buttons);
+  RotaryTimerWheel wheel;
+  for (unsigned int i = 0; i < buttons; i++) {
+    wheeled[i].timer.set(longPress, &wheeled[i]);
+    wheeled[i].fired = &fired;
+  }
+  seed = 7;
+  double start = seconds();
+  for (unsigned long now = 1; now <= ticks; now++) {
+    wheel.advance(now);
+    if (!randomNumber(75)) {
+      WheelButton &b = wheeled[randomNumber(buttons)];
+      wheel.schedule(b.timer, 600);
+    }
+  }
+  return (seconds() - start) * 1e9 / ticks;
+}
+
+int main() {
+  bool ok = correctness();
+  const unsigned long ticks = 2000000;
+  static const unsigned int counts[] = {8, 32, 128, 512, 2048};
+  printf("%8s %16s %16s %10s\n", "buttons", "polling ns/tick", "wheel ns/tick", "fired");
+  for (unsigned char i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+    unsigned long polledFired = 0;
+    unsigned long wheelFired = 0;
+    double polling = pollTicks(counts[i], ticks, polledFired);
+    double wheel = wheelTicks(counts[i], ticks, wheelFired);
+    // Both keep the same deadlines, so they fire the same number of times
+    ok &= polledFired == wheelFired;
+    printf("%8u %16.1f %16.1f %10lu\n", counts[i], polling, wheel, wheelFired);
+  }
+  printf("\nresult %s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
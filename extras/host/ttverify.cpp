@@ -0,0 +1,449 @@
+/*
+ * Exhaustive checker and minimizer for rotary state tables.
+ *
+ *   g++ -std=c++17 -O2 -pthread -I extras/host -I . rotary.cpp \
+ *       extras/host/ttverify.cpp -o ttverify
+ *   ./ttverify [-n length] [-f file] [half|full|buxton-half|buxton-full|all]
+ *
+ * The library's table is read from rotary.cpp itself, so it is "half" as
+ * rotary.h is shipped; build with HALF_STEP commented out in rotary.h to
+ * check "full". Ben Buxton's originals are only kept in rotary.cpp as
+ * comments, so they are copied here. -f reads any other table as rows of
+ * four numbers (hex or decimal, C comments and punctuation ignored), with
+ * the emit bits 0x10/0x20 as in rotary.cpp.
+ *
+ * For each table the tool
+ *  - finds the states reachable from R_START,
+ *  - checks that re-sampling an unchanged input never emits again and
+ *    settles the state within two samples,
+ *  - walks every input sequence up to the given length from each resting
+ *    code and checks that
+ *      direction: every event is emitted on a single-bit move in the
+ *                 event's direction, never on an invalid two-bit jump,
+ *      debounce:  while no jump has happened, the event count times the
+ *                 codes per event never drifts from the true quadrature
+ *                 position by a whole event, however the inputs bounce,
+ *  - merges equivalent states and prints the minimized table.
+ *
+ * The exit status is non-zero if any property fails.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "Arduino.h"
+#include "rotary.h"
+
+#define STATE_MASK 0x0f
+#define EMIT_MASK 0x30
+
+typedef std::vector<std::vector<unsigned char> > Table;
+
+// Clockwise order of the input codes, as (pin2 << 1) | pin1. This is the
+// 00>10>11>01 sequence that both current tables follow.
+static const unsigned char cwNext[4] = {2, 0, 3, 1};
+static const unsigned char ccwNext[4] = {1, 3, 0, 2};
+
+struct NamedTable {
+  const char *name;
+  Table rows;
+};
+
+// Reads the library's state tables, as a friend of Rotary. rotary.h does
+// not give their sizes, so rows are read up to the highest state that any
+// row read so far moves to.
+class RotaryTables
+{
+  public:
+    static Table ttable() {
+      return read(Rotary::ttable);
+    }
+  private:
+    static Table read(const unsigned char (*table)[4]) {
+      Table rows;
+      size_t count = 1;
+      for (size_t s = 0; s < count; s++) {
+        rows.push_back(std::vector<unsigned char>(table[s], table[s] + 4));
+        for (int i = 0; i < 4; i++) {
+          if ((size_t)(table[s][i] & STATE_MASK) >= count) count = (table[s][i] & STATE_MASK) + 1;
+        }
+      }
+      return rows;
+    }
+};
+
+static std::vector<NamedTable> builtinTables() {
+  std::vector<NamedTable> tables;
+  // The table rotary.cpp was built with, 00>10>11>01
+#ifdef HALF_STEP
+  tables.push_back({"half", RotaryTables::ttable()});
+#else
+  tables.push_back({"full", RotaryTables::ttable()});
+#endif
+  // Buxton's original half-step table
+  tables.push_back({"buxton-half", {
+    {0x3, 0x2, 0x1, 0x0},
+    {0x3 | DIR_CCW, 0x0, 0x1, 0x0},
+    {0x3 | DIR_CW, 0x2, 0x0, 0x0},
+    {0x3, 0x5, 0x4, 0x0},
+    {0x3, 0x3, 0x4, 0x0 | DIR_CW},
+    {0x3, 0x5, 0x3, 0x0 | DIR_CCW},
+  }});
+  // Buxton's original full-step table
+  tables.push_back({"buxton-full", {
+    {0x0, 0x2, 0x4, 0x0},
+    {0x3, 0x0, 0x1, 0x0 | DIR_CW},
+    {0x3, 0x2, 0x0, 0x0},
+    {0x3, 0x2, 0x1, 0x0},
+    {0x6, 0x0, 0x4, 0x0},
+    {0x6, 0x5, 0x0, 0x0 | DIR_CCW},
+    {0x6, 0x5, 0x4, 0x0},
+  }});
+  return tables;
+}
+
+static bool readTableFile(const char *path, Table &table) {
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    perror(path);
+    return false;
+  }
+  std::string text;
+  int c;
+  while ((c = fgetc(file)) != EOF) {
+    text += (char)c;
+  }
+  fclose(file);
+
+  std::vector<unsigned char> values;
+  size_t i = 0;
+  while (i < text.size()) {
+    if (text.compare(i, 2, "//") == 0) {
+      while (i < text.size() && text[i] != '\n') i++;
+    }
+    else if (text.compare(i, 2, "/*") == 0) {
+      size_t end = text.find("*/", i + 2);
+      i = end == std::string::npos ? text.size() : end + 2;
+    }
+    else if (isdigit((unsigned char)text[i])) {
+      char *end;
+      values.push_back((unsigned char)strtoul(text.c_str() + i, &end, 0));
+      i = end - text.c_str();
+    }
+    else {
+      i++;
+    }
+  }
+  if (values.empty() || values.size() % 4) {
+    fprintf(stderr, "%s: expected rows of 4 values, got %zu values\n", path, values.size());
+    return false;
+  }
+  table.clear();
+  for (size_t v = 0; v < values.size(); v += 4) {
+    table.push_back(std::vector<unsigned char>(values.begin() + v, values.begin() + v + 4));
+  }
+  return true;
+}
+
+static bool validTable(const Table &table) {
+  for (size_t s = 0; s < table.size(); s++) {
+    for (int i = 0; i < 4; i++) {
+      if ((table[s][i] & STATE_MASK) >= table.size() || (table[s][i] & EMIT_MASK) == EMIT_MASK) {
+        fprintf(stderr, "state %zu input %d: bad entry 0x%02x\n", s, i, table[s][i]);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static std::vector<bool> reachable(const Table &table) {
+  std::vector<bool> seen(table.size(), false);
+  std::vector<unsigned char> queue(1, 0);
+  seen[0] = true;
+  while (!queue.empty()) {
+    unsigned char s = queue.back();
+    queue.pop_back();
+    for (int i = 0; i < 4; i++) {
+      unsigned char next = table[s][i] & STATE_MASK;
+      if (!seen[next]) {
+        seen[next] = true;
+        queue.push_back(next);
+      }
+    }
+  }
+  return seen;
+}
+
+static int sign(unsigned char emit) {
+  return emit == DIR_CW ? 1 : emit == DIR_CCW ? -1 : 0;
+}
+
+// Exhaustive walk over input sequences.
+struct Walk {
+  const Table *table;
+  int length;
+  int codesPerEvent;
+  int orientation;
+  unsigned long sequences;
+  unsigned long directionFailures;
+  unsigned long debounceFailures;
+  std::string firstFailure;
+  std::vector<unsigned char> path;
+
+  void fail(unsigned long &counter, const char *what) {
+    if (!counter && firstFailure.empty()) {
+      firstFailure = std::string(what) + " after inputs";
+      for (size_t i = 0; i < path.size(); i++) {
+        char code[8];
+        snprintf(code, sizeof(code), " %d%d", path[i] >> 1, path[i] & 1);
+        firstFailure += code;
+      }
+    }
+    counter++;
+  }
+
+  // position: true quadrature position in codes; events: signed event sum;
+  // synced: false once a two-bit jump has been seen.
+  void step(unsigned char state, unsigned char input, int position, int events, bool synced, int depth) {
+    if (depth == length) {
+      sequences++;
+      return;
+    }
+    for (unsigned char next = 0; next < 4; next++) {
+      unsigned char entry = (*table)[state][next];
+      int emitted = sign(entry & EMIT_MASK) * orientation;
+      int move = next == input ? 0 : next == cwNext[input] ? 1 : next == ccwNext[input] ? -1 : 2;
+      path.push_back(next);
+      if (emitted && (move == 2 || move != emitted)) {
+        fail(directionFailures, "direction");
+      }
+      int newPosition = position + (move == 2 ? 0 : move);
+      int newEvents = events + emitted;
+      bool newSynced = synced && move != 2;
+      if (newSynced && abs(newEvents * codesPerEvent - newPosition) >= codesPerEvent) {
+        fail(debounceFailures, "debounce");
+      }
+      step(entry & STATE_MASK, next, newPosition, newEvents, newSynced, depth + 1);
+      path.pop_back();
+    }
+  }
+};
+
+// Events over one full clockwise cycle from a resting code, used to work
+// out the number of codes per event and which way round the table counts.
+static int cycleEvents(const Table &table, unsigned char rest) {
+  unsigned char state = 0;
+  unsigned char input = rest;
+  int events = 0;
+  for (int i = 0; i < 4; i++) {
+    input = cwNext[input];
+    unsigned char entry = table[state][input];
+    events += sign(entry & EMIT_MASK);
+    state = entry & STATE_MASK;
+  }
+  return events;
+}
+
+// Partition refinement over the reachable states. Returns the class of
+// each state, with the class of R_START numbered 0.
+static std::vector<int> minimize(const Table &table, const std::vector<bool> &live, int &classes) {
+  size_t n = table.size();
+  std::vector<int> cls(n, -1);
+  // Start by grouping states with the same outputs for every input.
+  std::vector<std::vector<int> > signatures;
+  for (size_t s = 0; s < n; s++) {
+    if (!live[s]) continue;
+    std::vector<int> signature;
+    for (int i = 0; i < 4; i++) signature.push_back(table[s][i] & EMIT_MASK);
+    size_t k = 0;
+    while (k < signatures.size() && signatures[k] != signature) k++;
+    if (k == signatures.size()) signatures.push_back(signature);
+    cls[s] = (int)k;
+  }
+  for (;;) {
+    // Split groups whose members move to different groups.
+    std::vector<std::vector<int> > keys;
+    std::vector<int> refined(n, -1);
+    for (size_t s = 0; s < n; s++) {
+      if (!live[s]) continue;
+      std::vector<int> key(1, cls[s]);
+      for (int i = 0; i < 4; i++) key.push_back(cls[table[s][i] & STATE_MASK]);
+      size_t k = 0;
+      while (k < keys.size() && keys[k] != key) k++;
+      if (k == keys.size()) keys.push_back(key);
+      refined[s] = (int)k;
+    }
+    bool stable = true;
+    for (size_t a = 0; a < n && stable; a++) {
+      for (size_t b = 0; b < n && stable; b++) {
+        if (live[a] && live[b] && (cls[a] == cls[b]) != (refined[a] == refined[b])) {
+          stable = false;
+        }
+      }
+    }
+    cls = refined;
+    if (stable) {
+      classes = (int)keys.size();
+      break;
+    }
+  }
+  // Renumber in breadth-first order from R_START.
+  std::vector<int> order(classes, -1);
+  std::vector<unsigned char> queue(1, 0);
+  int nextNumber = 0;
+  order[cls[0]] = nextNumber++;
+  for (size_t q = 0; q < queue.size(); q++) {
+    for (int i = 0; i < 4; i++) {
+      unsigned char next = table[queue[q]][i] & STATE_MASK;
+      if (order[cls[next]] < 0) {
+        order[cls[next]] = nextNumber++;
+        queue.push_back(next);
+      }
+    }
+  }
+  for (size_t s = 0; s < n; s++) {
+    if (live[s]) cls[s] = order[cls[s]];
+  }
+  return cls;
+}
+
+static int bitsFor(size_t states) {
+  int bits = 0;
+  while ((1u << bits) < states) bits++;
+  return bits;
+}
+
+static bool verify(const char *name, const Table &table, int length) {
+  printf("== %s: %zu states, %d state bits\n", name, table.size(), bitsFor(table.size()));
+  bool ok = true;
+
+  std::vector<bool> live = reachable(table);
+  std::string unreachable;
+  for (size_t s = 0; s < table.size(); s++) {
+    if (!live[s]) unreachable += " " + std::to_string(s);
+  }
+  printf("unreachable states:%s\n", unreachable.empty() ? " none" : unreachable.c_str());
+
+  // Resting codes are those R_START keeps on.
+  std::vector<unsigned char> rests;
+  for (unsigned char i = 0; i < 4; i++) {
+    if (table[0][i] == 0) rests.push_back(i);
+  }
+  if (rests.empty()) {
+    printf("FAIL: R_START has no resting input\n");
+    return false;
+  }
+
+  // An unchanged input may still move the state once, when the previous
+  // sample reset it to R_START, but must not emit and must then settle.
+  unsigned long unstable = 0;
+  unsigned long settleTwice = 0;
+  for (size_t s = 0; s < table.size(); s++) {
+    for (int i = 0; i < 4; i++) {
+      unsigned char next = table[s][i] & STATE_MASK;
+      unsigned char again = table[next][i] & STATE_MASK;
+      if (!live[s]) continue;
+      if ((table[next][i] & EMIT_MASK) || table[again][i] != again) unstable++;
+      else if (again != next) settleTwice++;
+    }
+  }
+  printf("repeated samples: %s (%lu failures, %lu entries settle on the second sample)\n",
+         unstable ? "FAIL" : "ok", unstable, settleTwice);
+  ok = ok && !unstable;
+
+  for (size_t r = 0; r < rests.size(); r++) {
+    int events = cycleEvents(table, rests[r]);
+    if (events == 0) {
+      printf("rest %d%d: a full cycle emits nothing, skipped\n", rests[r] >> 1, rests[r] & 1);
+      continue;
+    }
+    Walk walk;
+    walk.table = &table;
+    walk.length = length;
+    walk.orientation = events > 0 ? 1 : -1;
+    walk.codesPerEvent = 4 / abs(events);
+    walk.sequences = 0;
+    walk.directionFailures = 0;
+    walk.debounceFailures = 0;
+    walk.step(0, rests[r], 0, 0, true, 0);
+    printf("rest %d%d: %s, %d codes per event, %lu sequences of length %d\n",
+           rests[r] >> 1, rests[r] & 1, walk.orientation > 0 ? "00>10>11>01 is clockwise" : "00>10>11>01 is anti-clockwise",
+           walk.codesPerEvent, walk.sequences, length);
+    printf("  direction: %s (%lu failures)\n", walk.directionFailures ? "FAIL" : "ok", walk.directionFailures);
+    printf("  debounce:  %s (%lu failures)\n", walk.debounceFailures ? "FAIL" : "ok", walk.debounceFailures);
+    if (!walk.firstFailure.empty()) {
+      printf("  first failure: %s\n", walk.firstFailure.c_str());
+    }
+    ok = ok && !walk.directionFailures && !walk.debounceFailures;
+  }
+
+  int classes;
+  std::vector<int> cls = minimize(table, live, classes);
+  printf("minimized: %d states, %d state bits\n", classes, bitsFor(classes));
+  printf("const unsigned char ttable[%d][4] = {\n", classes);
+  for (int c = 0; c < classes; c++) {
+    std::string merged;
+    size_t first = 0;
+    for (size_t s = table.size(); s-- > 0;) {
+      if (live[s] && cls[s] == c) {
+        merged = " " + std::to_string(s) + merged;
+        first = s;
+      }
+    }
+    printf("  // was%s\n  {", merged.c_str());
+    for (int i = 0; i < 4; i++) {
+      unsigned char entry = table[first][i];
+      printf("0x%02x%s", (cls[entry & STATE_MASK]) | (entry & EMIT_MASK), i < 3 ? ", " : "},\n");
+    }
+  }
+  printf("};\n%s\n\n", ok ? "PASS" : "FAIL");
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  int length = 10;
+  std::vector<NamedTable> selected;
+  std::vector<NamedTable> builtins = builtinTables();
+
+  for (int a = 1; a < argc; a++) {
+    if (!strcmp(argv[a], "-n") && a + 1 < argc) {
+      length = atoi(argv[++a]);
+    }
+    else if (!strcmp(argv[a], "-f") && a + 1 < argc) {
+      NamedTable table = {argv[a + 1], Table()};
+      if (!readTableFile(argv[++a], table.rows)) return 2;
+      selected.push_back(table);
+    }
+    else if (!strcmp(argv[a], "all")) {
+      selected.insert(selected.end(), builtins.begin(), builtins.end());
+    }
+    else {
+      size_t t = 0;
+      while (t < builtins.size() && strcmp(builtins[t].name, argv[a])) t++;
+      if (t == builtins.size() && (!strcmp(argv[a], "half") || !strcmp(argv[a], "full"))) {
+        fprintf(stderr, "%s: build with HALF_STEP %s in rotary.h\n", argv[a],
+                strcmp(argv[a], "half") ? "commented out" : "defined");
+        return 2;
+      }
+      if (t == builtins.size()) {
+        fprintf(stderr, "usage: %s [-n length] [-f file] [half|full|buxton-half|buxton-full|all]\n", argv[0]);
+        return 2;
+      }
+      selected.push_back(builtins[t]);
+    }
+  }
+  if (selected.empty()) {
+    selected = builtins;
+  }
+
+  bool ok = true;
+  for (size_t t = 0; t < selected.size(); t++) {
+    if (!validTable(selected[t].rows)) return 2;
+    ok = verify(selected[t].name, selected[t].rows, length) && ok;
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,98 @@
+/*
+ * Host check of RotaryDebounceTuner.
+ *
+ *   g++ -std=c++17 -O2 -pthread -I extras/host -I . rotary.cpp \
+ *       rotary_tuner.cpp extras/host/tuner_bench.cpp -o tuner_bench
+ *   ./tuner_bench
+ *
+ * Presses and releases a button on the Arduino stand-in, on a simulated
+ * clock, with a bounce burst of known length on every edge. The sketch's
+ * loop is modelled by calling buttonPressedReleased() every LOOP_MICROS.
+ * Once the bursts are measured, the debounce delay must be the longest
+ * burst plus half again, rounded up to whole milliseconds. A second run
+ * has one slow contact bouncing for over 65.5 ms, which must not wrap as
+ * it would in 16 bits.
+ */
+
+#include <stdio.h>
+#include "Arduino.h"
+#include "rotary.h"
+#include "rotary_tuner.h"
+
+#define BUTTON_PIN 4
+#define LOOP_MICROS 50
+// Time between bounce edges within a burst, and a press or release
+// holding still.
+#define BOUNCE_EDGE 300
+#define HOLD_MICROS 100000
+
+static unsigned long now = 0;
+
+// Runs the loop until the given time.
+static void runUntil(RotaryDebounceTuner &tuner, unsigned long until) {
+  while (now < until) {
+    now += LOOP_MICROS;
+    hostSetMicros(now);
+    tuner.buttonPressedReleased();
+  }
+}
+
+// Moves the button to the given level, bouncing for burst microseconds
+// first, then holds it.
+static void edge(RotaryDebounceTuner &tuner, unsigned char level, unsigned long burst) {
+  unsigned long start = now;
+  unsigned long at = 0;
+  unsigned char bouncing = level;
+  while (at < burst) {
+    digitalWrite(BUTTON_PIN, bouncing);
+    bouncing = !bouncing;
+    at += BOUNCE_EDGE;
+    if (at > burst) {
+      at = burst;
+    }
+    runUntil(tuner, start + at);
+  }
+  digitalWrite(BUTTON_PIN, level);
+  runUntil(tuner, now + HOLD_MICROS);
+}
+
+// Presses and releases once per pair of bursts, then checks the tuning.
+static bool run(const char *name, const unsigned long *bursts, unsigned char count) {
+  Rotary encoder = Rotary(2, 3, BUTTON_PIN);
+  RotaryDebounceTuner tuner = RotaryDebounceTuner(encoder);
+  digitalWrite(BUTTON_PIN, HIGH);
+  runUntil(tuner, now + HOLD_MICROS);
+  tuner.begin();
+  unsigned long longest = 0;
+  for (unsigned char i = 0; i < count; i++) {
+    edge(tuner, i & 1 ? HIGH : LOW, bursts[i]);
+    if (bursts[i] > longest) {
+      longest = bursts[i];
+    }
+  }
+  unsigned long measured = 0;
+  for (unsigned char i = 0; i < tuner.samples(); i++) {
+    if (tuner.sample(i) > measured) {
+      measured = tuner.sample(i);
+    }
+  }
+  short expected = (longest + longest / 2 + 999) / 1000;
+  bool ok = !tuner.tuning() && tuner.samples() == ROTARY_BOUNCE_SAMPLES &&
+            tuner.debounce() == expected && labs((long)(measured - longest)) <= 2 * LOOP_MICROS;
+  printf("%-14s longest burst %6lu us, measured %6lu us, debounce %3d ms (expected %3d)   %s\n",
+         name, longest, measured, tuner.debounce(), expected, ok ? "PASS" : "FAIL");
+  return ok;
+}
+
+int main() {
+  static const unsigned long typical[ROTARY_BOUNCE_SAMPLES] = {
+    800, 1500, 2200, 3400, 1200, 900, 2600, 1700
+  };
+  static const unsigned long slow[ROTARY_BOUNCE_SAMPLES] = {
+    800, 1500, 2200, 70200, 1200, 900, 2600, 1700
+  };
+  bool ok = run("typical", typical, ROTARY_BOUNCE_SAMPLES);
+  ok &= run("slow contact", slow, ROTARY_BOUNCE_SAMPLES);
+  printf("\nresult %s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
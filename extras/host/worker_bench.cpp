@@ -0,0 +1,135 @@
+/*
+ * Two-thread host benchmark for RotaryWorker.
+ *
+ *   g++ -std=c++17 -O2 -pthread -I extras/host -I . rotary.cpp \
+ *       rotary_worker.cpp extras/host/worker_bench.cpp -o worker_bench
+ *   ./worker_bench [steps]
+ *
+ * A worker thread decodes four encoders while the main thread turns them
+ * clockwise through the pin variables and keeps reading the published
+ * slots. Every read must be internally consistent (events == position,
+ * never going backwards) and the final positions must match the steps
+ * driven. Reports worker passes per second and reads per second. Then
+ * checks that serviceLevels() decodes pins past 31 and that add() refuses
+ * pins its level word cannot hold.
+ */
+
+#include <stdio.h>
+#include <thread>
+#include "Arduino.h"
+#include "rotary.h"
+#include "rotary_worker.h"
+
+#define ENCODERS 4
+
+static Rotary encoders[ENCODERS] = {
+  Rotary(2, 3), Rotary(4, 5), Rotary(6, 7), Rotary(8, 9)
+};
+
+static RotaryWorker worker;
+
+// Clockwise Gray sequence as (pin2 << 1) | pin1.
+static const unsigned char cwSequence[4] = {2, 3, 1, 0};
+
+static unsigned long reads = 0;
+static unsigned long errors = 0;
+static long lastSeen[ENCODERS];
+
+// Turns an encoder on pins 38 and 39 through serviceLevels(), and offers
+// the worker one on pins it cannot decode.
+static bool checkHighPins() {
+  Rotary high = Rotary(38, 39);
+  Rotary beyond = Rotary(ROTARY_WORKER_LEVELS, ROTARY_WORKER_LEVELS + 1);
+  RotaryWorker levelWorker;
+  bool ok = levelWorker.add(high) == 0 && levelWorker.add(beyond) == -1;
+  for (unsigned char q = 0; q < 8; q++) {
+    unsigned char code = cwSequence[q & 3];
+    levelWorker.serviceLevels((uint64_t)(code & 1) << 38 | (uint64_t)(code >> 1) << 39);
+  }
+  RotaryWorkerReading reading;
+  levelWorker.read(0, reading);
+  long expected = 2;
+#ifdef HALF_STEP
+  expected *= 2;
+#endif
+  ok = ok && reading.position == expected;
+  printf("pins 38 and 39  position %ld   %s\n", reading.position, ok ? "PASS" : "FAIL");
+  return ok;
+}
+
+static void checkSlots() {
+  for (unsigned char i = 0; i < ENCODERS; i++) {
+    RotaryWorkerReading reading;
+    worker.read(i, reading);
+    reads++;
+    if ((unsigned long)reading.position != reading.events || reading.position < lastSeen[i]) {
+      errors++;
+    }
+    lastSeen[i] = reading.position;
+  }
+}
+
+// Waits until the worker has sampled the pins at least twice, reading
+// slots meanwhile. Yielding keeps this usable on a single-CPU host.
+static void settle() {
+  unsigned long start = worker.passes();
+  while (worker.passes() - start < 2) {
+    checkSlots();
+    std::this_thread::yield();
+  }
+}
+
+int main(int argc, char **argv) {
+  long steps = argc > 1 ? atol(argv[1]) : 2000;
+
+  for (unsigned char i = 0; i < ENCODERS; i++) {
+    worker.add(encoders[i]);
+  }
+  // Pull-ups leave the pins at 11; start the encoders at rest on 00.
+  for (unsigned char pin = 2; pin <= 9; pin++) {
+    digitalWrite(pin, LOW);
+  }
+
+  std::thread decoder(&RotaryWorker::run, &worker);
+  settle();
+
+  unsigned long startPasses = worker.passes();
+  unsigned long startMicros = micros();
+  for (long step = 0; step < steps; step++) {
+    for (unsigned char q = 0; q < 4; q++) {
+      for (unsigned char i = 0; i < ENCODERS; i++) {
+        digitalWrite(2 + 2 * i, cwSequence[q] & 1);
+        digitalWrite(3 + 2 * i, cwSequence[q] >> 1);
+      }
+      settle();
+    }
+  }
+  unsigned long elapsed = micros() - startMicros;
+  unsigned long passes = worker.passes() - startPasses;
+
+  worker.stop();
+  decoder.join();
+  checkSlots();
+
+  long expected = steps;
+#ifdef HALF_STEP
+  expected *= 2;
+#endif
+  bool ok = errors == 0;
+  for (unsigned char i = 0; i < ENCODERS; i++) {
+    if (lastSeen[i] != expected) {
+      ok = false;
+    }
+  }
+
+  double seconds = elapsed / 1e6;
+  printf("encoders        %d\n", ENCODERS);
+  printf("steps driven    %ld (expected count %ld)\n", steps, expected);
+  printf("worker passes   %.0f /s (%.1f ns per encoder sample)\n",
+         passes / seconds, seconds * 1e9 / passes / ENCODERS);
+  printf("slot reads      %.0f /s\n", reads / seconds);
+  printf("bad reads       %lu\n", errors);
+  ok &= checkHighPins();
+  printf("result          %s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
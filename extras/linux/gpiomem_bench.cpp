@@ -0,0 +1,136 @@
+/*
+ * Checks RotaryGpioMem against a regular file standing in for
+ * /dev/gpiomem, and compares its cost per sample with a read() syscall.
+ *
+ *   g++ -std=c++17 -O2 -pthread -I extras/host -I extras/linux -I . \
+ *       rotary.cpp rotary_worker.cpp extras/linux/rotary_linux.cpp \
+ *       extras/linux/gpiomem_bench.cpp -o gpiomem_bench
+ *   ./gpiomem_bench [file] [steps]
+ *
+ * The file (a temporary one by default) is mapped writable as the fake
+ * register block. Four encoders sit on bits 4 to 11 of the level register
+ * at ROTARY_GPLEV0, with buttons on bits 20 to 23. The bench turns even
+ * encoders clockwise and odd ones anti-clockwise, writing each Gray code
+ * into the register, samples it through RotaryGpioMem and the worker, and
+ * checks the decoded positions and buttons. It then times reading the
+ * register with a load from the mapping and with pread().
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include "Arduino.h"
+#include "rotary.h"
+#include "rotary_worker.h"
+#include "rotary_linux.h"
+
+#define ENCODERS 4
+#define MAP_LENGTH 4096
+#define READS 1000000
+
+static Rotary encoders[ENCODERS] = {
+  Rotary(4, 5, 20), Rotary(6, 7, 21), Rotary(8, 9, 22), Rotary(10, 11, 23)
+};
+
+static RotaryWorker worker;
+
+// Gray sequences as (pin2 << 1) | pin1, from rest on 00.
+static const unsigned char cwSequence[4] = {2, 3, 1, 0};
+static const unsigned char ccwSequence[4] = {1, 3, 2, 0};
+
+static double nanosSince(const struct timespec &start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start.tv_sec) * 1e9 + (now.tv_nsec - start.tv_nsec);
+}
+
+int main(int argc, char **argv) {
+  char path[] = "/tmp/gpiomemXXXXXX";
+  const char *file = argc > 1 ? argv[1] : path;
+  long steps = argc > 2 ? atol(argv[2]) : 1000;
+
+  int fd = argc > 1 ? open(file, O_RDWR | O_CREAT, 0600) : mkstemp(path);
+  if (fd < 0 || ftruncate(fd, MAP_LENGTH) != 0) {
+    fprintf(stderr, "%s: cannot create\n", file);
+    return 2;
+  }
+  void *block = mmap(NULL, MAP_LENGTH, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (block == MAP_FAILED) {
+    fprintf(stderr, "%s: cannot map\n", file);
+    return 2;
+  }
+  volatile uint32_t *level = (volatile uint32_t *)((char *)block + ROTARY_GPLEV0);
+  // Buttons open, encoders at rest on 00
+  *level = 0xfUL << 20;
+
+  RotaryGpioMem lines;
+  if (!lines.open(file, ROTARY_GPLEV0, MAP_LENGTH)) {
+    fprintf(stderr, "%s: RotaryGpioMem cannot open\n", file);
+    return 2;
+  }
+  for (unsigned char i = 0; i < ENCODERS; i++) {
+    worker.addWithButton(encoders[i]);
+  }
+
+  // Every button is held down for the middle step
+  bool ok = true;
+  unsigned long levels;
+  for (long step = 0; step < steps; step++) {
+    uint32_t buttons = step == steps / 2 ? 0 : 0xfUL << 20;
+    for (unsigned char q = 0; q < 4; q++) {
+      uint32_t value = buttons;
+      for (unsigned char i = 0; i < ENCODERS; i++) {
+        value |= (uint32_t)(i & 1 ? ccwSequence[q] : cwSequence[q]) << (4 + 2 * i);
+      }
+      *level = value;
+      ok &= lines.read(levels) && levels == value;
+      worker.serviceLevels(levels);
+    }
+    for (unsigned char i = 0; i < ENCODERS; i++) {
+      RotaryWorkerReading reading;
+      worker.read(i, reading);
+      ok &= reading.button == (buttons ? encoders[i].BUTTON_RELEASED : encoders[i].BUTTON_PRESSED);
+    }
+  }
+  long expected = steps;
+#ifdef HALF_STEP
+  expected *= 2;
+#endif
+  for (unsigned char i = 0; i < ENCODERS; i++) {
+    RotaryWorkerReading reading;
+    worker.read(i, reading);
+    if (reading.position != (i & 1 ? -expected : expected)) {
+      ok = false;
+    }
+  }
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (long i = 0; i < READS; i++) {
+    lines.read(levels);
+  }
+  double mapped = nanosSince(start) / READS;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (long i = 0; i < READS; i++) {
+    uint32_t value;
+    if (pread(fd, &value, sizeof(value), ROTARY_GPLEV0) != sizeof(value)) {
+      ok = false;
+    }
+  }
+  double syscall = nanosSince(start) / READS;
+
+  lines.close();
+  munmap(block, MAP_LENGTH);
+  close(fd);
+  if (argc < 2) {
+    unlink(path);
+  }
+
+  printf("steps driven    %ld (expected count %ld)\n", steps, expected);
+  printf("mapped load     %.1f ns per sample (%.1f M samples/s)\n", mapped, 1e3 / mapped);
+  printf("pread()         %.1f ns per sample (%.1f M samples/s)\n", syscall, 1e3 / syscall);
+  printf("result          %s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+/*
+ * Sample rate and jitter of RotaryLinuxPoller, on simulated lines.
+ *
+ *   g++ -std=c++17 -O2 -pthread -I extras/host -I extras/linux -I . \
+ *       rotary.cpp rotary_worker.cpp extras/linux/rotary_linux.cpp \
+ *       extras/linux/linux_bench.cpp -o linux_bench
+ *   ./linux_bench [-r rateHz] [-q quartersPerSecond] [-s seconds]
+ *                 [-c cpu] [-p fifoPriority]
+ *
+ * Four simulated encoders with buttons turn at a steady rate while the
+ * poller samples them. Reports the achieved sample rate, missed samples
+ * and how late samples were taken. The decoded positions must match the
+ * simulation. A step is lost whenever the thread is held up for longer
+ * than a quarter-step, so this also shows whether the CPU is really
+ * free: on a shared CPU, preemption alone loses steps.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include "Arduino.h"
+#include "rotary.h"
+#include "rotary_worker.h"
+#include "rotary_linux.h"
+
+#define ENCODERS 4
+
+static Rotary encoders[ENCODERS] = {
+  Rotary(0, 1, 16), Rotary(2, 3, 18), Rotary(4, 5, 20), Rotary(6, 7, 22)
+};
+
+static RotaryWorker worker;
+
+int main(int argc, char **argv) {
+  unsigned long rate = 100000;
+  unsigned long quarterRate = 1000;
+  double seconds = 2;
+  int cpu = -1;
+  int priority = 0;
+  int option;
+  while ((option = getopt(argc, argv, "r:q:s:c:p:")) != -1) {
+    switch (option) {
+      case 'r': rate = atol(optarg); break;
+      case 'q': quarterRate = atol(optarg); break;
+      case 's': seconds = atof(optarg); break;
+      case 'c': cpu = atoi(optarg); break;
+      case 'p': priority = atoi(optarg); break;
+      default: return 2;
+    }
+  }
+
+  for (unsigned char i = 0; i < ENCODERS; i++) {
+    worker.addWithButton(encoders[i]);
+  }
+  RotarySimulatedLines lines(ENCODERS, quarterRate);
+  RotaryLinuxPoller poller(worker, lines);
+  if (!poller.start(rate, cpu, priority)) {
+    fprintf(stderr, "cannot start the poller thread\n");
+    return 2;
+  }
+  usleep((useconds_t)(seconds * 1e6));
+  poller.stop();
+
+  RotaryPollStats stats;
+  poller.stats(stats);
+  long expected = lines.quarters() / 4;
+#ifdef HALF_STEP
+  expected = lines.quarters() / 2;
+#endif
+  bool ok = stats.errors == 0;
+  long lost = 0;
+  for (unsigned char i = 0; i < ENCODERS; i++) {
+    RotaryWorkerReading reading;
+    worker.read(i, reading);
+    lost += labs(reading.position - (i & 1 ? -expected : expected));
+    if (reading.button != encoders[i].BUTTON_RELEASED) {
+      ok = false;
+    }
+  }
+  if (lost) {
+    ok = false;
+  }
+
+  printf("scheduling      %s, cpu %d\n", poller.realtime() ? "SCHED_FIFO" : "normal", cpu);
+  printf("target rate     %lu Hz\n", rate);
+  printf("achieved rate   %.0f Hz (%llu samples in %.2f s)\n",
+         stats.samples / stats.seconds, stats.samples, stats.seconds);
+  printf("missed samples  %llu\n", stats.missed);
+  printf("lateness        mean %.2f us, max %.2f us\n", stats.meanLateness, stats.maxLateness);
+  for (unsigned char b = 0; b < ROTARY_LINUX_BUCKETS; b++) {
+    if (!stats.histogram[b]) {
+      continue;
+    }
+    char label[16];
+    if (b == ROTARY_LINUX_BUCKETS - 1) {
+      snprintf(label, sizeof(label), ">= %lu us", 1UL << (b - 1));
+    }
+    else {
+      snprintf(label, sizeof(label), "< %lu us", 1UL << b);
+    }
+    printf("  %-13s %llu\n", label, stats.histogram[b]);
+  }
+  printf("steps           %ld per encoder, %ld lost in total\n", expected, lost);
+  printf("result          %s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
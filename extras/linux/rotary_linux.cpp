@@ -0,0 +1,307 @@
+/*
+ * Busy-poll backend for Linux single-board computers.
+ *
+ * The poller thread spins on the monotonic clock rather than sleeping,
+ * because a sleep's wake-up latency is exactly the jitter this backend is
+ * meant to avoid. Deadlines are absolute, so lateness never accumulates;
+ * if the thread falls more than a whole period behind, the deadlines it
+ * missed are skipped and counted instead of being read back to back.
+ *
+ * Under SCHED_FIFO a spinning thread would lock everything else off its
+ * CPU, apart from the kernel's real-time throttling, so only combine it
+ * with a CPU that nothing else needs.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/gpio.h>
+#include <math.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include "Arduino.h"
+#include "rotary_linux.h"
+
+static uint64_t monotonicNanos() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+RotaryGpioLines::RotaryGpioLines() {
+  fd = -1;
+  count = 0;
+}
+
+RotaryGpioLines::~RotaryGpioLines() {
+  close();
+}
+
+/*
+ * Requests lines of a GPIO chip as inputs, optionally with pull-ups.
+ * offsets[n] becomes line n of the source. Returns false if the chip
+ * cannot be opened or the lines are busy.
+ */
+bool RotaryGpioLines::open(const char *chip, const unsigned int *offsets, unsigned char lines, bool pullups) {
+  close();
+  if (lines > ROTARY_LINUX_LINES) {
+    return false;
+  }
+  int chipFd = ::open(chip, O_RDONLY | O_CLOEXEC);
+  if (chipFd < 0) {
+    return false;
+  }
+  struct gpio_v2_line_request request;
+  memset(&request, 0, sizeof(request));
+  for (unsigned char i = 0; i < lines; i++) {
+    request.offsets[i] = offsets[i];
+  }
+  request.num_lines = lines;
+  strncpy(request.consumer, "rotary", sizeof(request.consumer) - 1);
+  request.config.flags = GPIO_V2_LINE_FLAG_INPUT;
+  if (pullups) {
+    request.config.flags |= GPIO_V2_LINE_FLAG_BIAS_PULL_UP;
+  }
+  bool ok = ioctl(chipFd, GPIO_V2_GET_LINE_IOCTL, &request) == 0;
+  ::close(chipFd);
+  if (!ok) {
+    return false;
+  }
+  fd = request.fd;
+  count = lines;
+  return true;
+}
+
+void RotaryGpioLines::close() {
+  if (fd >= 0) {
+    ::close(fd);
+    fd = -1;
+  }
+}
+
+bool RotaryGpioLines::read(unsigned long &levels) {
+  struct gpio_v2_line_values values;
+  values.mask = count < 64 ? (1ULL << count) - 1 : ~0ULL;
+  values.bits = 0;
+  if (ioctl(fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) != 0) {
+    return false;
+  }
+  levels = values.bits;
+  return true;
+}
+
+RotaryGpioMem::RotaryGpioMem() {
+  map = MAP_FAILED;
+  length = 0;
+  level = 0;
+}
+
+RotaryGpioMem::~RotaryGpioMem() {
+  close();
+}
+
+/*
+ * Maps the first mapLength bytes of a GPIO register block, eg.
+ * /dev/gpiomem, read-only, and reads the 32-bit level register at
+ * registerOffset. Returns false if the device cannot be mapped or the
+ * register is misaligned or outside the mapping.
+ */
+bool RotaryGpioMem::open(const char *path, unsigned long registerOffset, unsigned long mapLength) {
+  close();
+  if (registerOffset % 4 || registerOffset + 4 > mapLength) {
+    return false;
+  }
+  int fd = ::open(path, O_RDONLY | O_SYNC | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  map = mmap(NULL, mapLength, PROT_READ, MAP_SHARED, fd, 0);
+  // The mapping stays valid once the descriptor is closed
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    return false;
+  }
+  length = mapLength;
+  level = (const volatile uint32_t *)((const char *)map + registerOffset);
+  return true;
+}
+
+void RotaryGpioMem::close() {
+  if (map != MAP_FAILED) {
+    munmap(map, length);
+    map = MAP_FAILED;
+    level = 0;
+  }
+}
+
+bool RotaryGpioMem::read(unsigned long &levels) {
+  if (!level) {
+    return false;
+  }
+  levels = *level;
+  return true;
+}
+
+// Clockwise Gray sequence as (pin2 << 1) | pin1, starting at rest on 00.
+static const unsigned char simulatedSequence[4] = {0, 2, 3, 1};
+
+/*
+ * Simulates encoders turning at the given number of quarter-steps (pin
+ * transitions) per second. Even encoders turn clockwise and odd ones
+ * anti-clockwise.
+ */
+RotarySimulatedLines::RotarySimulatedLines(unsigned char count, unsigned long rate) {
+  encoders = count;
+  quartersPerSecond = rate;
+  start = monotonicNanos();
+  lastQuarters = 0;
+}
+
+bool RotarySimulatedLines::read(unsigned long &levels) {
+  uint64_t elapsed = monotonicNanos() - start;
+  lastQuarters = (unsigned long long)((double)elapsed * quartersPerSecond / 1e9);
+  levels = 0;
+  for (unsigned char i = 0; i < encoders; i++) {
+    unsigned char code = simulatedSequence[(i & 1 ? -lastQuarters : lastQuarters) & 3];
+    levels |= (unsigned long)code << (2 * i);
+    // Buttons open
+    levels |= 1UL << (2 * i + 16);
+  }
+  return true;
+}
+
+/*
+ * Quarter-steps each encoder had turned at the last read.
+ */
+unsigned long long RotarySimulatedLines::quarters() {
+  return lastQuarters;
+}
+
+RotaryLinuxPoller::RotaryLinuxPoller(RotaryWorker &decoder, RotaryLineSource &lines)
+    : worker(decoder), source(lines) {
+  started = false;
+  fifo = false;
+  cpu = -1;
+  period = 0;
+  running = false;
+  memset(&results, 0, sizeof(results));
+}
+
+/*
+ * Starts sampling at rateHz on a new thread. A cpu of -1 leaves the
+ * thread free to migrate; a priority above 0 asks for SCHED_FIFO at that
+ * priority, and falls back to normal scheduling when not permitted (see
+ * realtime()). Returns false if the thread could not be started, for
+ * example because the CPU does not exist.
+ */
+bool RotaryLinuxPoller::start(unsigned long rateHz, int onCpu, int priority) {
+  if (started || !rateHz) {
+    return false;
+  }
+  period = 1000000000ULL / rateHz;
+  cpu = onCpu;
+  memset(&results, 0, sizeof(results));
+  running = true;
+
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  if (cpu >= 0) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+  }
+  int error = EPERM;
+  if (priority > 0) {
+    struct sched_param param;
+    param.sched_priority = priority;
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+    pthread_attr_setschedparam(&attr, &param);
+    error = pthread_create(&handle, &attr, thread, this);
+    fifo = error == 0;
+    pthread_attr_setinheritsched(&attr, PTHREAD_INHERIT_SCHED);
+  }
+  if (error == EPERM) {
+    // Not allowed to run real-time, carry on without it
+    error = pthread_create(&handle, &attr, thread, this);
+  }
+  pthread_attr_destroy(&attr);
+  started = error == 0;
+  return started;
+}
+
+/*
+ * Stops the thread and waits for it to finish.
+ */
+void RotaryLinuxPoller::stop() {
+  if (!started) {
+    return;
+  }
+  running = false;
+  pthread_join(handle, NULL);
+  started = false;
+}
+
+/*
+ * True if the thread got SCHED_FIFO.
+ */
+bool RotaryLinuxPoller::realtime() {
+  return fifo;
+}
+
+/*
+ * Copies the statistics of the last run. Call after stop().
+ */
+void RotaryLinuxPoller::stats(RotaryPollStats &copy) {
+  copy = results;
+}
+
+void *RotaryLinuxPoller::thread(void *poller) {
+  ((RotaryLinuxPoller *)poller)->loop();
+  return NULL;
+}
+
+void RotaryLinuxPoller::loop() {
+  double totalLateness = 0;
+  uint64_t begin = monotonicNanos();
+  uint64_t deadline = begin;
+  while (running.load(std::memory_order_relaxed)) {
+    uint64_t now;
+    do {
+      now = monotonicNanos();
+    } while (now < deadline);
+
+    unsigned long levels;
+    if (source.read(levels)) {
+      worker.serviceLevels(levels);
+    }
+    else {
+      results.errors++;
+    }
+
+    double late = (now - deadline) / 1000.0;
+    totalLateness += late;
+    if (late > results.maxLateness) {
+      results.maxLateness = late;
+    }
+    unsigned char bucket = late < 1 ? 0 : (unsigned char)(log2(late) + 1);
+    if (bucket >= ROTARY_LINUX_BUCKETS) {
+      bucket = ROTARY_LINUX_BUCKETS - 1;
+    }
+    results.histogram[bucket]++;
+    results.samples++;
+
+    deadline += period;
+    if (now >= deadline + period) {
+      uint64_t skipped = (now - deadline) / period;
+      results.missed += skipped;
+      deadline += skipped * period;
+    }
+  }
+  results.seconds = (monotonicNanos() - begin) / 1e9;
+  results.meanLateness = results.samples ? totalLateness / results.samples : 0;
+}
@@ -0,0 +1,132 @@
+/*
+ * Busy-poll backend for Linux single-board computers.
+ *
+ *   g++ -std=c++17 -O2 -pthread -I extras/host -I extras/linux -I . \
+ *       rotary.cpp rotary_worker.cpp extras/linux/rotary_linux.cpp your.cpp
+ *
+ * Edge events through the GPIO character device arrive with too much
+ * scheduling latency for fast encoders. RotaryLinuxPoller instead runs a
+ * thread pinned to one CPU, ideally one kept free with isolcpus=, that
+ * reads every encoder line in one bulk read at a fixed rate and hands the
+ * levels to RotaryWorker::serviceLevels(). Results are published through
+ * the worker's lock-free slots, so the application reads them with
+ * RotaryWorker::read() as on a dual-core board.
+ *
+ * Encoder pin numbers are positions in the line source's list of lines,
+ * not GPIO numbers: Rotary(0, 1, 2) uses the source's first three lines.
+ */
+
+#ifndef rotary_linux_h
+#define rotary_linux_h
+
+#include <pthread.h>
+#include <stdint.h>
+#include <atomic>
+#include "rotary_worker.h"
+
+// Most lines one source reads, one bit each in the levels passed to
+// RotaryWorker::serviceLevels().
+#define ROTARY_LINUX_LINES 32
+
+// Level register of the first GPIO bank (GPLEV0) in the block mapped by
+// /dev/gpiomem on a Raspberry Pi up to the 4.
+#define ROTARY_GPLEV0 0x34
+
+// Lateness histogram buckets: bucket n counts samples taken between
+// 2^(n-1) and 2^n microseconds late, the last one everything later.
+#define ROTARY_LINUX_BUCKETS 12
+
+// Something that can read the levels of all encoder lines at once.
+class RotaryLineSource
+{
+  public:
+    virtual ~RotaryLineSource() {}
+    // Bit n of the result is the level of line n. Returns false on error.
+    virtual bool read(unsigned long &) = 0;
+};
+
+// Lines requested from a GPIO character device, eg. /dev/gpiochip0, and
+// read with one GPIO_V2_LINE_GET_VALUES_IOCTL per sample.
+class RotaryGpioLines : public RotaryLineSource
+{
+  public:
+    RotaryGpioLines();
+    ~RotaryGpioLines();
+    bool open(const char *, const unsigned int *, unsigned char, bool);
+    void close();
+    bool read(unsigned long &);
+  private:
+    int fd;
+    unsigned char count;
+};
+
+// The SoC's GPIO level register, mapped from /dev/gpiomem and read with a
+// single load per sample. Encoder pin numbers are then bit numbers in the
+// register, eg. BCM GPIO numbers for a Raspberry Pi's GPLEV0. Any file at
+// least as long as the mapping works as a stand-in.
+class RotaryGpioMem : public RotaryLineSource
+{
+  public:
+    RotaryGpioMem();
+    ~RotaryGpioMem();
+    bool open(const char *, unsigned long, unsigned long);
+    void close();
+    bool read(unsigned long &);
+  private:
+    void *map;
+    unsigned long length;
+    const volatile uint32_t *level;
+};
+
+// Encoders turning at a steady rate, computed from the clock at every
+// read, for running the poller without hardware. Encoder n is on lines
+// 2n and 2n + 1, and its button, which is never pressed, on line 2n + 16.
+class RotarySimulatedLines : public RotaryLineSource
+{
+  public:
+    RotarySimulatedLines(unsigned char, unsigned long);
+    bool read(unsigned long &);
+    unsigned long long quarters();
+  private:
+    unsigned char encoders;
+    unsigned long quartersPerSecond;
+    uint64_t start;
+    unsigned long long lastQuarters;
+};
+
+// Sampling statistics. Lateness is how long after its deadline a sample
+// was read, in microseconds; missed samples are deadlines skipped
+// entirely because the thread was running more than a period late.
+struct RotaryPollStats {
+  unsigned long long samples;
+  unsigned long long missed;
+  unsigned long long errors;
+  double seconds;
+  double meanLateness;
+  double maxLateness;
+  unsigned long long histogram[ROTARY_LINUX_BUCKETS];
+};
+
+class RotaryLinuxPoller
+{
+  public:
+    RotaryLinuxPoller(RotaryWorker &, RotaryLineSource &);
+    bool start(unsigned long, int, int);
+    void stop();
+    bool realtime();
+    void stats(RotaryPollStats &);
+  private:
+    static void *thread(void *);
+    void loop();
+    RotaryWorker &worker;
+    RotaryLineSource &source;
+    pthread_t handle;
+    bool started;
+    bool fifo;
+    int cpu;
+    uint64_t period;
+    std::atomic<bool> running;
+    RotaryPollStats results;
+};
+
+#endif
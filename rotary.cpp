@@ -103,7 +103,7 @@
 /* Modified 5/04/2019 by Carlos Siles
   * Modified table to follow sequence 00>10>11>01>01
   */
-const unsigned char ttable[6][4] = {
+const unsigned char Rotary::ttable[6][4] = {
   // R_START (00)
   {R_START,           R_CCW_BEGIN,  R_CW_BEGIN,    R_START_M},
   // R_CCW_BEGIN
@@ -149,7 +149,7 @@ const unsigned char ttable[6][4] = {
   * Modified table to follow sequence 00>10>11>01>01
   */
   
-const unsigned char ttable[7][4] = {
+const unsigned char Rotary::ttable[7][4] = {
 // R_START
 {R_START,           R_CCW_BEGIN, R_CW_BEGIN,   R_START},
   // R_CW_FINAL
@@ -168,6 +168,72 @@ const unsigned char ttable[7][4] = {
 
 #endif
 
+/*
+ * Reduced table for processChannelA(), used when only pin 1 (channel A)
+ * has an interrupt. The state is simply the last level of A, and the
+ * level of pin 2 (channel B) at an edge of A gives the direction.
+ */
+#define R_A_LOW 0x0
+#define R_A_HIGH 0x1
+
+#ifdef HALF_STEP
+// Every edge of A emits, ie. twice per step like the half-step table
+const unsigned char Rotary::atable[2][4] = {
+  // R_A_LOW
+  {R_A_LOW,           R_A_HIGH | DIR_CCW, R_A_LOW,           R_A_HIGH | DIR_CW},
+  // R_A_HIGH
+  {R_A_LOW | DIR_CW,  R_A_HIGH,           R_A_LOW | DIR_CCW, R_A_HIGH},
+};
+#else
+// Only the edges of A next to 00 emit, ie. once per step
+const unsigned char Rotary::atable[2][4] = {
+  // R_A_LOW
+  {R_A_LOW,           R_A_HIGH | DIR_CCW, R_A_LOW,           R_A_HIGH},
+  // R_A_HIGH
+  {R_A_LOW | DIR_CW,  R_A_HIGH,           R_A_LOW,           R_A_HIGH},
+};
+#endif
+
+/*
+ * Tables for pulse inputs, see setInputMode(). Pulse sources are driven
+ * digital outputs rather than contacts, so they are counted on every
+ * rising edge with no debounce. Half-step mode does not apply.
+ *
+ * Step/direction: the state is the last level of the step input (pin 1),
+ * and the level of the direction input (pin 2) at a rising edge of step
+ * gives the direction.
+ */
+#define R_STEP_LOW 0x0
+#define R_STEP_HIGH 0x1
+
+const unsigned char Rotary::sdtable[2][4] = {
+  // R_STEP_LOW
+  {R_STEP_LOW, R_STEP_HIGH | DIR_CCW, R_STEP_LOW, R_STEP_HIGH | DIR_CW},
+  // R_STEP_HIGH
+  {R_STEP_LOW, R_STEP_HIGH,           R_STEP_LOW, R_STEP_HIGH},
+};
+
+/*
+ * Up/down: the state is the last level of both inputs. A rising edge of
+ * pin 1 counts clockwise and one of pin 2 anti-clockwise; if both rise
+ * between two samples they cancel out.
+ */
+#define R_UD_IDLE 0x0
+#define R_UD_UP 0x1
+#define R_UD_DOWN 0x2
+#define R_UD_BOTH 0x3
+
+const unsigned char Rotary::udtable[4][4] = {
+  // R_UD_IDLE
+  {R_UD_IDLE, R_UD_UP | DIR_CW, R_UD_DOWN | DIR_CCW, R_UD_BOTH},
+  // R_UD_UP
+  {R_UD_IDLE, R_UD_UP,          R_UD_DOWN | DIR_CCW, R_UD_BOTH | DIR_CCW},
+  // R_UD_DOWN
+  {R_UD_IDLE, R_UD_UP | DIR_CW, R_UD_DOWN,           R_UD_BOTH | DIR_CW},
+  // R_UD_BOTH
+  {R_UD_IDLE, R_UD_UP,          R_UD_DOWN,           R_UD_BOTH},
+};
+
 /*
  * Constructor. Each arg is the pin number for each encoder contact.
  */
@@ -208,16 +274,444 @@ void Rotary::init(char _pin1, char _pin2) {
   digitalWrite(pin2, HIGH);
 #endif
   // Initialise state.
+  table = ttable;
+  mode = ROTARY_INPUT_QUADRATURE;
   state = R_START;
+  position = 0;
+  // Adaptive polling is off until setAdaptivePoll() is called.
+  pollDivider = 1;
+  pollTick = 0;
+  pollHold = 0;
+  pollHoldCount = 0;
+  // No interrupts until attachInterrupts(), and no storm limit.
+  isr = 0;
+  channelA = false;
+  stormed = false;
+  stormLimit = 0;
+  stormWindow = 0;
+  stormHits = 0;
+  stormEvents = 0;
+  stormTimer = 0;
+  // No recovery until setRecovery() is called.
+  recovery = false;
+  lastPins = 0;
+  lastDir = 0;
+  lastQuarter = 0;
+  quarterPeriod = 0;
+  inferred = 0;
+}
+
+/*
+ * Returns the number of steps counted by process() since the last reset.
+ * Interrupts are held off for the copy, so this is safe to call while an
+ * interrupt handler keeps processing the encoder.
+ */
+long Rotary::readPosition() {
+  noInterrupts();
+  long result = position;
+  interrupts();
+  return result;
+}
+
+/*
+ * Sets the step count back to zero.
+ */
+void Rotary::resetPosition() {
+  noInterrupts();
+  position = 0;
+  changes++;
+  interrupts();
+}
+
+/*
+ * Returns the state of the decoding table, which with readPosition() is
+ * everything process() carries from one pin state to the next.
+ */
+unsigned char Rotary::readState() {
+  return state;
 }
 
-unsigned char Rotary::process() {
-  // Grab state of input pins.
+/*
+ * Puts back a state from readState() and a step count, so that decoding
+ * carries on as it would have from where they were read.
+ */
+void Rotary::restoreState(unsigned char saved, long steps) {
+  noInterrupts();
+  state = saved;
+  position = steps;
+  changes++;
+  interrupts();
+}
+
+/*
+ * Switches between decoding a quadrature encoder (ROTARY_INPUT_QUADRATURE,
+ * the default) and counting pulse trains from motion controllers and
+ * other digital sources:
+ *
+ *   ROTARY_INPUT_STEP_DIR  a step pulse on pin 1 counts one step, in the
+ *                          direction given by pin 2: high for clockwise
+ *   ROTARY_INPUT_UP_DOWN   a pulse on pin 1 counts one step clockwise, a
+ *                          pulse on pin 2 one step anti-clockwise
+ *
+ * Pulses count on their rising edge. Everything else works as before:
+ * positions, results, interrupts, polling and readVelocity(), which gives
+ * pulses per second. In step/direction mode attachInterruptA() suits
+ * best, as only the step input needs an interrupt. The current levels are
+ * taken as the starting point, so a line that idles high does not count.
+ */
+void Rotary::setInputMode(unsigned char inputMode) {
+  // The mode decides which pins have interrupts, so move them over
+  bool attached = isr && !stormed;
+  if (attached) {
+    detachPins();
+  }
+  noInterrupts();
+  mode = inputMode;
   unsigned char pinstate = (digitalRead(pin2) << 1) | digitalRead(pin1);
-  // Determine new state from the pins and state table.
-  state = ttable[state & 0xf][pinstate];
-  // Return emit bits, ie the generated event.
-  return state & 0x30;
+  if (mode == ROTARY_INPUT_STEP_DIR) {
+    table = sdtable;
+    state = pinstate & 1 ? R_STEP_HIGH : R_STEP_LOW;
+  }
+  else if (mode == ROTARY_INPUT_UP_DOWN) {
+    table = udtable;
+    state = pinstate;
+  }
+  else {
+    mode = ROTARY_INPUT_QUADRATURE;
+    table = ttable;
+    state = R_START;
+  }
+  lastPins = pinstate;
+  lastDir = 0;
+  quarterPeriod = 0;
+  interrupts();
+  if (attached) {
+    attachPins();
+  }
+}
+
+/*
+ * Returns the input mode set by setInputMode().
+ */
+unsigned char Rotary::inputMode() {
+  return mode;
+}
+
+/*
+ * Returns true while the state machine is part way through a step, ie.
+ * the encoder has left its resting code. In half-step mode both the 00
+ * and the 11 positions count as rest. Pulse inputs are never part way
+ * through a step.
+ */
+bool Rotary::isActive() {
+  if (mode != ROTARY_INPUT_QUADRATURE) {
+    return false;
+  }
+#ifdef HALF_STEP
+  return (state & 0xf) != R_START && (state & 0xf) != R_START_M;
+#else
+  return (state & 0xf) != R_START;
+#endif
+}
+
+/*
+ * Configures adaptive polling for sketches that call poll() from a
+ * fixed-rate timer interrupt. While the encoder is at rest only every
+ * idleDivider-th call reads the pins. The first transition away from
+ * rest switches to reading on every call, and reading stays fast until
+ * the encoder has been back at rest for holdTicks calls.
+ * An idleDivider of 1 (the default) reads the pins on every call.
+ */
+void Rotary::setAdaptivePoll(unsigned char idleDivider, unsigned int holdTicks) {
+  pollDivider = idleDivider ? idleDivider : 1;
+  pollHold = holdTicks;
+  pollTick = 0;
+  pollHoldCount = 0;
+}
+
+/*
+ * Timer-driven replacement for process(). Returns the same codes, but
+ * skips reading the pins on idle ticks as set up by setAdaptivePoll().
+ */
+unsigned char Rotary::poll() {
+  if (isr && !stormed) {
+    // Interrupts are doing the work
+    return DIR_NONE;
+  }
+  if (!isActive() && pollHoldCount == 0) {
+    // Idle: only sample on every pollDivider-th tick
+    if (++pollTick < pollDivider) {
+      return DIR_NONE;
+    }
+  }
+  pollTick = 0;
+  unsigned char before = state;
+  unsigned char result = process();
+  if (isActive() || result) {
+    // Moving: keep sampling at the full rate for a while after it settles
+    pollHoldCount = pollHold;
+  }
+  else if (pollHoldCount) {
+    pollHoldCount--;
+  }
+  if (stormed) {
+    stormSettle(state != before);
+  }
+  return result;
+}
+
+// Next pin state in each direction, indexed by the current one.
+static const unsigned char cwNext[4] = {2, 0, 3, 1};
+static const unsigned char ccwNext[4] = {1, 3, 0, 2};
+
+/*
+ * Turns recovery of missed transitions on or off. When sampling falls
+ * behind a fast spin, the pins can change from 00 straight to 11 (or 01
+ * to 10) between two samples, and the state table discards the jump,
+ * losing the two transitions. With recovery on, process() keeps track of
+ * the direction and speed of the last transitions. A jump that comes
+ * within ROTARY_RECOVERY_SPAN quarter-step periods of the last transition
+ * is taken as the encoder carrying on in the same direction: the skipped
+ * pin state is fed to the table first, and any step that results is
+ * flagged with DIR_INFERRED. Jumps with no recent motion to go by are
+ * still discarded.
+ *
+ * This only holds while the encoder moves at most two quarter-steps
+ * between samples. Pins alone cannot tell three quarter-steps one way
+ * from one the other way, so beyond that speed some samples are taken as
+ * a reversal and the count runs backwards. Sample often enough to keep
+ * under two quarter-steps at the fastest expected spin.
+ *
+ * Tracking costs a micros() call on every transition.
+ */
+void Rotary::setRecovery(bool enable) {
+  recovery = enable;
+  lastDir = 0;
+  quarterPeriod = 0;
+}
+
+unsigned char Rotary::recover(unsigned char pinstate) {
+  if (mode != ROTARY_INPUT_QUADRATURE) {
+    // Pulse inputs have no transitions to infer; only time the counts
+    unsigned char result = advance(table[state & 0xf][pinstate]);
+    if (result) {
+      unsigned long now = micros();
+      signed char dir = result == DIR_CW ? 1 : -1;
+      if (dir != lastDir) {
+        lastDir = dir;
+        quarterPeriod = 0;
+      }
+      unsigned long elapsed = now - lastQuarter;
+      quarterPeriod = quarterPeriod ? (3 * quarterPeriod + elapsed) / 4 : elapsed;
+      lastQuarter = now;
+    }
+    return result;
+  }
+  unsigned char moved = pinstate ^ lastPins;
+  if (!moved) {
+    return advance(ttable[state & 0xf][pinstate]);
+  }
+  unsigned long now = micros();
+  unsigned long elapsed = now - lastQuarter;
+  unsigned char result;
+  if (moved == 3) {
+    // Two quarter-steps went by
+    elapsed /= 2;
+    if (lastDir && elapsed <= ROTARY_RECOVERY_SPAN * quarterPeriod) {
+      unsigned char skipped = lastDir > 0 ? cwNext[lastPins] : ccwNext[lastPins];
+      result = advance(ttable[state & 0xf][skipped]);
+      result |= advance(ttable[state & 0xf][pinstate]);
+      if (result) {
+        result |= DIR_INFERRED;
+        inferred++;
+      }
+    }
+    else {
+      // Nothing to infer the direction from, let the table discard it
+      lastDir = 0;
+      result = advance(ttable[state & 0xf][pinstate]);
+    }
+  }
+  else {
+    result = advance(ttable[state & 0xf][pinstate]);
+    signed char dir = cwNext[lastPins] == pinstate ? 1 : -1;
+    if (dir != lastDir) {
+      // Starting or turning round: the speed starts afresh
+      lastDir = dir;
+      quarterPeriod = 0;
+    }
+  }
+  // Smooth the quarter-step period over the last few transitions
+  quarterPeriod = quarterPeriod ? (3 * quarterPeriod + elapsed) / 4 : elapsed;
+  lastPins = pinstate;
+  lastQuarter = now;
+  return result;
+}
+
+/*
+ * Speed while recovery is on, in quarter-steps (pin transitions) per
+ * second, positive clockwise. It falls off as the time since the last
+ * transition grows, and is 0 until two transitions in a row have gone
+ * the same way.
+ */
+long Rotary::readVelocity() {
+  if (!lastDir || !quarterPeriod) {
+    return 0;
+  }
+  unsigned long period = quarterPeriod;
+  unsigned long elapsed = micros() - lastQuarter;
+  if (elapsed > period) {
+    period = elapsed;
+  }
+  long speed = 1000000UL / period;
+  return lastDir > 0 ? speed : -speed;
+}
+
+/*
+ * Number of steps produced from inferred transitions.
+ */
+unsigned int Rotary::inferredCount() {
+  return inferred;
+}
+
+/*
+ * Attaches the given handler as a CHANGE interrupt on both encoder pins.
+ * The handler should call processInterrupt(). Pins without an external
+ * interrupt are skipped by attachInterrupt().
+ */
+void Rotary::attachInterrupts(void (*handler)()) {
+  isr = handler;
+  channelA = false;
+  stormed = false;
+  stormHits = 0;
+  stormTimer = millis();
+  attachPins();
+}
+
+/*
+ * Detaches the encoder's interrupts. poll() then reads the pins again.
+ */
+void Rotary::detachInterrupts() {
+  detachPins();
+  isr = 0;
+  channelA = false;
+  stormed = false;
+}
+
+/*
+ * Attaches the given handler as a CHANGE interrupt on pin 1 (channel A)
+ * only, for boards short of interrupt pins. The handler should call
+ * processChannelA(). This halves the interrupt load of attachInterrupts()
+ * but only sees half the transitions, see processChannelA(). With
+ * step/direction inputs only the step pin needs an interrupt, so no
+ * transitions are missed; up/down inputs still get one on both pins.
+ */
+void Rotary::attachInterruptA(void (*handler)()) {
+  isr = handler;
+  channelA = true;
+  stormed = false;
+  stormHits = 0;
+  stormTimer = millis();
+  attachPins();
+}
+
+/*
+ * Whether attachPins() puts an interrupt on pin 2 as well as pin 1. After
+ * attachInterruptA() it only does for up/down inputs, where both pins
+ * carry pulses.
+ */
+bool Rotary::attachesPin2() {
+  return !channelA || mode == ROTARY_INPUT_UP_DOWN;
+}
+
+void Rotary::attachPins() {
+  if (channelA && mode == ROTARY_INPUT_QUADRATURE) {
+    // Start the reduced table from the current level of A
+    state = digitalRead(pin1) ? R_A_HIGH : R_A_LOW;
+  }
+  if (attachesPin2()) {
+    attachInterrupt(digitalPinToInterrupt(pin2), isr, CHANGE);
+  }
+  attachInterrupt(digitalPinToInterrupt(pin1), isr, CHANGE);
+}
+
+void Rotary::detachPins() {
+  detachInterrupt(digitalPinToInterrupt(pin1));
+  if (attachesPin2()) {
+    detachInterrupt(digitalPinToInterrupt(pin2));
+  }
+  if (channelA && mode == ROTARY_INPUT_QUADRATURE) {
+    // poll() decodes with the full table, start it afresh. Pulse inputs
+    // use the same table either way.
+    state = R_START;
+  }
+}
+
+/*
+ * Enables storm protection: if maxInterrupts interrupts arrive within
+ * windowMillis, the encoder's interrupts are detached and poll() takes
+ * over through the same state table. Once a whole window passes with no
+ * more than ROTARY_STORM_QUIET pin changes seen by poll(), interrupts are
+ * attached again. A maxInterrupts of 0 disables the check.
+ */
+void Rotary::setStormLimit(unsigned int maxInterrupts, unsigned int windowMillis) {
+  stormLimit = maxInterrupts;
+  stormWindow = windowMillis;
+  stormHits = 0;
+  stormTimer = millis();
+}
+
+/*
+ * Called from stormCheck() every stormLimit interrupts. Hands the encoder
+ * over to poll() if they came in less than a window.
+ */
+void Rotary::stormTrip() {
+  unsigned long now = millis();
+  if (now - stormTimer < stormWindow) {
+    // Too many interrupts too quickly, hand over to poll()
+    detachPins();
+    stormed = true;
+    stormEvents++;
+  }
+  stormHits = 0;
+  stormTimer = now;
+}
+
+/*
+ * Called by poll() while stormed, with whether the sample changed the
+ * state. Re-attaches interrupts after a quiet window.
+ */
+void Rotary::stormSettle(bool changed) {
+  if (changed) {
+    stormHits++;
+  }
+  unsigned long now = millis();
+  if (now - stormTimer >= stormWindow) {
+    if (stormHits <= ROTARY_STORM_QUIET) {
+      stormed = false;
+      attachPins();
+    }
+    stormHits = 0;
+    stormTimer = now;
+  }
+}
+
+/*
+ * True while a storm has the encoder on polling instead of interrupts.
+ */
+bool Rotary::stormActive() {
+  return stormed;
+}
+
+/*
+ * Number of storms detected so far. The count is bumped by the interrupt
+ * handler, so interrupts are held off for the copy.
+ */
+unsigned int Rotary::stormCount() {
+  noInterrupts();
+  unsigned int result = stormEvents;
+  interrupts();
+  return result;
 }
 
 /*
@@ -303,6 +797,39 @@ bool Rotary::buttonPressedHeld(short delay_millis) {
   return false;
 }
 
+/*
+ * Reads the encoder button, and returns true as soon as a press is seen,
+ * on the first sample that finds the pin LOW. The button is then ignored
+ * for lockout_millis, which swallows the bounce of the press, and again
+ * for lockout_millis after the release, which swallows its bounce. A
+ * second press is only reported once both lockouts are over and the
+ * button has been released in between.
+ *
+ * Unlike buttonPressedReleased(), nothing filters the first edge, so a
+ * glitch on the line reads as a press.
+ */
+bool Rotary::buttonPressedLeading(short lockout_millis) {
+  if (buttonState == BUTTON_RESET) {
+    if (!digitalRead(buttonPin)) {                      // the first LOW sample is the press
+      buttonState = BUTTON_PRESSED;                     // lock out the press bounce
+      buttonTimer = millis();
+      return true;
+    }
+  }
+  else if (millis() - buttonTimer > (unsigned long)lockout_millis) {   // the lockout has expired
+    if (buttonState == BUTTON_PRESSED) {
+      if (digitalRead(buttonPin)) {                     // released, lock out the release bounce
+        buttonState = BUTTON_RELEASED;
+        buttonTimer = millis();
+      }
+    }
+    else {
+      buttonState = BUTTON_RESET;                       // ready for the next press
+    }
+  }
+  return false;
+}
+
 /*
 * Reads the encoder button and returns the current state (pressed OR released)
 * Does not return the composite state (just for checking the state right now)
@@ -13,6 +13,10 @@
 // Enable weak pullups
 #define ENABLE_PULLUPS
 
+// Pin number for an optional pin that is not connected. Pins that may
+// take it are signed char, as plain char is unsigned on some targets.
+#define ROTARY_NO_PIN -1
+
 // Values returned by 'process'
 // No complete step yet.
 #define DIR_NONE 0x0
@@ -20,10 +24,57 @@
 #define DIR_CW 0x10
 // Anti-clockwise step.
 #define DIR_CCW 0x20
+// Set alongside DIR_CW or DIR_CCW when setRecovery() inferred a missed
+// transition to produce the step.
+#define DIR_INFERRED 0x40
+
+// Input modes for setInputMode().
+// Two-bit Gray code from a rotary encoder (the default).
+#define ROTARY_INPUT_QUADRATURE 0
+// Step pulses on pin 1, direction level on pin 2 (high for clockwise).
+#define ROTARY_INPUT_STEP_DIR 1
+// Clockwise pulses on pin 1, anti-clockwise pulses on pin 2.
+#define ROTARY_INPUT_UP_DOWN 2
+
+// Button events, for code that logs or queues them next to DIR_CW and
+// DIR_CCW.
+// Pressed and released (buttonPressedReleased).
+#define EVENT_CLICK 0x01
+// Held down (buttonPressedHeld).
+#define EVENT_HOLD 0x02
+// Pressed, reported on the leading edge (buttonPressedLeading).
+#define EVENT_PRESS 0x04
+
+// One encoder or button event, as logged or queued by the application.
+struct RotaryEvent {
+  unsigned long time;
+  unsigned char source;
+  unsigned char event;
+};
+
+// Quarter-step periods since the last transition within which a two-code
+// jump is taken as a missed transition by setRecovery().
+#define ROTARY_RECOVERY_SPAN 4
+
+// Pin changes seen by polling, per storm window, below which a stormed
+// encoder goes back to interrupts.
+#define ROTARY_STORM_QUIET 4
+
+// Orders memory accesses between a writer and a reader on another core
+// or in an interrupt handler.
+#if defined(__AVR__)
+#define ROTARY_BARRIER() __asm__ __volatile__("" ::: "memory")
+#else
+#define ROTARY_BARRIER() __sync_synchronize()
+#endif
 
 
 class Rotary
 {
+  friend class RotaryGroup;
+  friend class RotaryWorker;
+  // Host tools that check the state tables, see extras/host/ttverify.cpp
+  friend class RotaryTables;
   public:
     const unsigned char BUTTON_RESET = 0x00;
     const unsigned char BUTTON_PRESSED = 0x01;
@@ -33,21 +84,189 @@ class Rotary
     Rotary(char, char, char);
     // Process pin(s)
     unsigned char process();
+    unsigned char process(unsigned char);
+    // Interrupt-driven processing, with fallback to poll() during storms
+    void attachInterrupts(void (*)());
+    void detachInterrupts();
+    unsigned char processInterrupt();
+    void attachInterruptA(void (*)());
+    unsigned char processChannelA();
+    // Step/direction or up/down pulse inputs instead of quadrature
+    void setInputMode(unsigned char);
+    unsigned char inputMode();
+    void setStormLimit(unsigned int, unsigned int);
+    bool stormActive();
+    unsigned int stormCount();
+    // Adaptive polling from a fixed-rate timer
+    void setAdaptivePoll(unsigned char, unsigned int);
+    unsigned char poll();
+    bool isActive();
+    // Step count, +1 for each clockwise and -1 for each anti-clockwise step
+    long readPosition();
+    void resetPosition();
+    // Decoder snapshot, for tools that checkpoint and resume a decode
+    unsigned char readState();
+    void restoreState(unsigned char, long);
+    // Recovery of transitions missed by slow sampling
+    void setRecovery(bool);
+    long readVelocity();
+    unsigned int inferredCount();
     unsigned char clockwise();
     unsigned char counterClockwise();
     bool buttonPressedReleased(short);
     bool buttonPressedHeld(short);
+    bool buttonPressedLeading(short);
     unsigned char readButton();
     void resetButton();
   private:
   	void init(char, char);
+    unsigned char advance(unsigned char);
+    bool attachesPin2();
+    void attachPins();
+    void detachPins();
+    void stormCheck();
+    void stormTrip();
+    void stormSettle(bool);
+    unsigned char recover(unsigned char);
+    // State tables, see rotary.cpp
+    static const unsigned char ttable[][4];
+    static const unsigned char atable[][4];
+    static const unsigned char sdtable[][4];
+    static const unsigned char udtable[][4];
+    // Table in use by process(), see setInputMode()
+    const unsigned char (*table)[4];
+    unsigned char mode;
     unsigned char state;
+    volatile long position;
+    // Bumped on every position change, to detect torn reads
+    volatile unsigned char changes;
     unsigned char pin1;
     unsigned char pin2;
     unsigned char buttonPin;
     unsigned char buttonState;
     unsigned long buttonTimer;
+    unsigned char pollDivider;
+    unsigned char pollTick;
+    unsigned int pollHold;
+    unsigned int pollHoldCount;
+    void (*isr)();
+    bool channelA;
+    volatile bool stormed;
+    unsigned int stormLimit;
+    unsigned int stormWindow;
+    unsigned int stormHits;
+    volatile unsigned int stormEvents;
+    unsigned long stormTimer;
+    bool recovery;
+    unsigned char lastPins;
+    signed char lastDir;
+    unsigned long lastQuarter;
+    unsigned long quarterPeriod;
+    unsigned int inferred;
 };
 
+/*
+ * The decoding path is defined here rather than in rotary.cpp so that it
+ * can be inlined into interrupt handlers, see rotaryInterrupt() below.
+ */
+
+inline unsigned char Rotary::process() {
+  // Grab state of input pins.
+  unsigned char pinstate = (digitalRead(pin2) << 1) | digitalRead(pin1);
+  return process(pinstate);
+}
+
+/*
+ * Same as process(), for pin states sampled elsewhere: bit 0 is pin 1
+ * and bit 1 is pin 2.
+ */
+inline unsigned char Rotary::process(unsigned char pinstate) {
+  if (recovery) {
+    return recover(pinstate);
+  }
+  // Determine new state from the pins and state table.
+  return advance(table[state & 0xf][pinstate]);
+}
+
+/*
+ * Moves to the new state from a state table and counts any step it emits.
+ */
+inline unsigned char Rotary::advance(unsigned char next) {
+  state = next;
+  unsigned char result = state & 0x30;
+  // Keep a running count of steps.
+  if (result == DIR_CW) {
+    position++;
+    changes++;
+  }
+  else if (result == DIR_CCW) {
+    position--;
+    changes++;
+  }
+  // Return emit bits, ie the generated event.
+  return result;
+}
+
+/*
+ * Counts interrupts for storm protection. This costs an increment and a
+ * compare; the clock is only read once every stormLimit interrupts.
+ */
+inline void Rotary::stormCheck() {
+  if (stormLimit && ++stormHits >= stormLimit) {
+    stormTrip();
+  }
+}
+
+/*
+ * Body of the encoder's interrupt handler after attachInterrupts().
+ */
+inline unsigned char Rotary::processInterrupt() {
+  stormCheck();
+  return process();
+}
+
+/*
+ * Body of the encoder's interrupt handler after attachInterruptA().
+ * Each edge of A samples B and steps the reduced table, so the encoder
+ * resolves two of the four transitions in each cycle. Bounce on B is
+ * never seen; bounce on A shows up as steps back and forth that cancel
+ * out in the position rather than being filtered like in process().
+ * In step/direction mode pin 1 is the step input, so every step is seen.
+ */
+inline unsigned char Rotary::processChannelA() {
+  stormCheck();
+  if (stormed) {
+    return DIR_NONE;
+  }
+  unsigned char pinstate = (digitalRead(pin2) << 1) | digitalRead(pin1);
+  if (mode != ROTARY_INPUT_QUADRATURE) {
+    // Pulse inputs decode the same on every path
+    return process(pinstate);
+  }
+  return advance(atable[state & 0xf][pinstate]);
+}
+
+/*
+ * Interrupt handlers bound to one encoder at compile time, so a sketch
+ * needs no handler of its own per encoder:
+ *
+ *   Rotary rotary = Rotary(2, 3);
+ *   rotary.attachInterrupts(rotaryInterrupt<rotary>);
+ *
+ * The encoder is a template argument rather than a pointer, so the
+ * handler addresses it directly and the decoding above is inlined into
+ * it. The encoder must be a global (or otherwise static) object.
+ */
+template <Rotary &encoder>
+void rotaryInterrupt() {
+  encoder.processInterrupt();
+}
+
+// Same as rotaryInterrupt(), for attachInterruptA().
+template <Rotary &encoder>
+void rotaryInterruptA() {
+  encoder.processChannelA();
+}
+
 #endif
  
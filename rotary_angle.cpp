@@ -0,0 +1,134 @@
+/*
+ * Angle and revolution tracking.
+ *
+ * 360 degrees in 16.16 fixed point is 360 << 16. Dividing that by the
+ * counts per revolution once gives the degrees per count as a 16.16
+ * whole part and a further 16 bits of fraction. The angle of a count is
+ * then the count times the whole part, plus the count times the fraction
+ * shifted down 16 bits. With fewer than 65536 counts the first product
+ * stays below 360 << 16 and the second fits 32 bits, and the result is
+ * within one unit of the exact angle. On AVR both products are 16 by 32
+ * and 16 by 16 bit multiplies, where a 32-bit division is a loop of 32
+ * shifts and subtracts.
+ */
+
+#include "rotary_angle.h"
+
+RotaryAngle::RotaryAngle(unsigned int countsPerRevolution) {
+  setCountsPerRevolution(countsPerRevolution);
+}
+
+/*
+ * Sets the counts in one revolution, 1 to 65535, and starts again from
+ * count 0 of revolution 0. This is where the division is done.
+ */
+void RotaryAngle::setCountsPerRevolution(unsigned int countsPerRevolution) {
+  if (countsPerRevolution == 0) {
+    countsPerRevolution = 1;
+  }
+  unsigned long full = 360UL << 16;
+  unsigned long rest = full % countsPerRevolution;
+  noInterrupts();
+  counts = countsPerRevolution;
+  perCount = full / countsPerRevolution;
+  perCountFraction = (rest << 16) / countsPerRevolution;
+  interrupts();
+  reset();
+}
+
+unsigned int RotaryAngle::countsPerRevolution() {
+  return counts;
+}
+
+/*
+ * Makes the current position count 0 of revolution 0 for step(), and
+ * position 0 of the encoder angle 0 for update().
+ */
+void RotaryAngle::reset() {
+  noInterrupts();
+  within = 0;
+  turns = 0;
+  interrupts();
+  last = 0;
+}
+
+/*
+ * Moves the angle to the given encoder position, for sketches that read
+ * the encoder with readPosition() rather than stepping the angle in the
+ * interrupt handler. Use this or step(), not both. A move of less than a
+ * revolution since the last call only adds and compares. Longer jumps, such
+ * as the first call after a reset() away from position 0, fall back to a
+ * division.
+ */
+void RotaryAngle::update(long position) {
+  long delta = position - last;
+  last = position;
+  long whole = 0;
+  if (delta >= (long)counts || delta <= -(long)counts) {
+    whole = delta / (long)counts;
+    delta -= whole * (long)counts;
+  }
+  long next = (long)within + delta;
+  if (next >= (long)counts) {
+    next -= (long)counts;
+    whole++;
+  }
+  else if (next < 0) {
+    next += (long)counts;
+    whole--;
+  }
+  noInterrupts();
+  within = next;
+  turns += whole;
+  interrupts();
+}
+
+/*
+ * Returns the count within the current revolution, from 0 to one less
+ * than the counts per revolution.
+ */
+unsigned int RotaryAngle::count() {
+  noInterrupts();
+  unsigned int result = within;
+  interrupts();
+  return result;
+}
+
+/*
+ * Returns the number of whole revolutions, clockwise positive. Position 0
+ * to one count short of a revolution anti-clockwise of it is revolution -1.
+ */
+long RotaryAngle::revolutions() {
+  noInterrupts();
+  long result = turns;
+  interrupts();
+  return result;
+}
+
+/*
+ * Returns the angle within the revolution in 16.16 fixed-point degrees,
+ * from 0 up to but not including 360 * ROTARY_DEGREE.
+ */
+long RotaryAngle::degrees() {
+  return degreesAt(count());
+}
+
+/*
+ * Reads the revolutions and the angle together, so that they agree even
+ * if the angle wraps in between.
+ */
+void RotaryAngle::read(long &revolutions, long &degrees) {
+  noInterrupts();
+  unsigned int at = within;
+  revolutions = turns;
+  interrupts();
+  degrees = degreesAt(at);
+}
+
+/*
+ * Returns the angle of the given count in 16.16 fixed-point degrees,
+ * without dividing. Also safe in an interrupt handler.
+ */
+long RotaryAngle::degreesAt(unsigned int at) {
+  return at * perCount + (((unsigned long)at * perCountFraction + 0x8000) >> 16);
+}
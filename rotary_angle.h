@@ -0,0 +1,76 @@
+/*
+ * Angle and revolution tracking for any number of counts per revolution.
+ *
+ * Keeps the position as a count within the revolution, from 0 to one less
+ * than the counts per revolution, and a signed number of whole
+ * revolutions. Both are updated a step at a time, so neither needs a
+ * division. Angles come out in 16.16 fixed-point degrees, through a
+ * degrees-per-count factor worked out once in setCountsPerRevolution().
+ * That way the interrupt handler and the loop only multiply, never divide.
+ *
+ * Counts are whatever the encoder counts: steps in full-step or half-step
+ * mode, or pulses in the pulse input modes.
+ */
+
+#ifndef rotary_angle_h
+#define rotary_angle_h
+
+#include "rotary.h"
+
+// One degree in the 16.16 fixed point of degrees().
+#define ROTARY_DEGREE 0x10000L
+
+class RotaryAngle
+{
+  public:
+    RotaryAngle(unsigned int);
+    void setCountsPerRevolution(unsigned int);
+    unsigned int countsPerRevolution();
+    void reset();
+    // Interrupt side: the result of process()
+    void step(unsigned char);
+    // Loop side: a position from readPosition()
+    void update(long);
+    unsigned int count();
+    long revolutions();
+    long degrees();
+    void read(long &, long &);
+    long degreesAt(unsigned int);
+  private:
+    unsigned int counts;
+    // Degrees per count in 16.16 fixed point, and the next 16 bits of
+    // its fraction
+    unsigned long perCount;
+    unsigned int perCountFraction;
+    volatile unsigned int within;
+    volatile long turns;
+    // Last position given to update()
+    long last;
+};
+
+/*
+ * Moves the angle one count on a DIR_CW or DIR_CCW result, wrapping into
+ * the next or previous revolution. Cheap enough to call from the encoder's
+ * interrupt handler with the result of process(). Defined here, like
+ * process(), so that it can be inlined into the handler.
+ */
+inline void RotaryAngle::step(unsigned char result) {
+  result &= DIR_CW | DIR_CCW;
+  if (result == DIR_CW) {
+    if (++within == counts) {
+      within = 0;
+      turns++;
+    }
+  }
+  else if (result == DIR_CCW) {
+    if (within == 0) {
+      within = counts - 1;
+      turns--;
+    }
+    else {
+      within--;
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,196 @@
+/*
+ * Encoder co-processor register map.
+ *
+ * begin(), read(), write() and end() carry no bus framing, so the same
+ * map serves any transport. For I2C, the first byte the master writes is
+ * passed to begin() and the rest to write(); each byte the master reads
+ * comes from read(), and end() is called at the stop condition (see the
+ * Coprocessor example). For SPI, call begin() with the first byte after
+ * chip select and end() when it is released.
+ *
+ * The bus handlers usually run in interrupt context while service() runs
+ * from loop(), so service() holds interrupts off while it touches the
+ * status register.
+ */
+
+#include "Arduino.h"
+#include "rotary_coprocessor.h"
+
+RotaryCoprocessor::RotaryCoprocessor(RotaryGroup &encoders) : group(encoders) {
+  memset(image, 0, sizeof(image));
+  for (unsigned char i = 0; i < ROTARY_GROUP_SIZE; i++) {
+    reported[i] = 0;
+    delta[i] = 0;
+    buttons[i] = 0;
+    latched[i] = 0;
+  }
+  status = 0;
+  mask = 0xff;
+  pointer = 0;
+  touched = 0;
+  active = false;
+  resetPending = false;
+  interruptPin = ROTARY_NO_PIN;
+}
+
+/*
+ * Drives the given pin low while any unmasked status bit is set, for the
+ * main controller's interrupt input. It idles high.
+ */
+void RotaryCoprocessor::setInterruptPin(signed char pin) {
+  interruptPin = pin;
+  pinMode(pin, OUTPUT);
+  digitalWrite(pin, HIGH);
+}
+
+/*
+ * Flags encoders that changed since they were last read and updates the
+ * interrupt line. Call from loop(), after servicing the encoders. A reset
+ * written to the control register is carried out here, outside the bus
+ * handler.
+ */
+void RotaryCoprocessor::service() {
+  if (resetPending) {
+    group.resetPositions();
+    noInterrupts();
+    for (unsigned char i = 0; i < ROTARY_GROUP_SIZE; i++) {
+      reported[i] = 0;
+    }
+    resetPending = false;
+    interrupts();
+  }
+  RotarySnapshot snap;
+  group.snapshot(snap);
+  // end() updates these from the bus handler
+  long seen[ROTARY_GROUP_SIZE];
+  unsigned char pressed[ROTARY_GROUP_SIZE];
+  noInterrupts();
+  for (unsigned char i = 0; i < snap.count; i++) {
+    seen[i] = reported[i];
+    pressed[i] = buttons[i];
+  }
+  interrupts();
+  unsigned char changed = 0;
+  for (unsigned char i = 0; i < snap.count; i++) {
+    unsigned char button = snap.button[i] == 0x01;
+    if (snap.position[i] != seen[i] || button != pressed[i]) {
+      changed |= 1 << i;
+    }
+  }
+  noInterrupts();
+  // A transaction in progress settles the status itself when it ends
+  if (!active) {
+    status = changed;
+  }
+  bool raise = status & mask;
+  interrupts();
+  if (interruptPin != ROTARY_NO_PIN) {
+    digitalWrite(interruptPin, raise ? LOW : HIGH);
+  }
+}
+
+void RotaryCoprocessor::latch() {
+  RotarySnapshot snap;
+  group.snapshot(snap);
+  memset(image, 0, sizeof(image));
+  image[ROTARY_REG_ID] = ROTARY_COPRO_ID;
+  image[ROTARY_REG_VERSION] = ROTARY_COPRO_VERSION;
+  image[ROTARY_REG_COUNT] = snap.count;
+  image[ROTARY_REG_INT_MASK] = mask;
+  unsigned char changed = 0;
+  for (unsigned char i = 0; i < snap.count; i++) {
+    unsigned char *block = image + ROTARY_REG_ENCODERS + i * ROTARY_COPRO_STRIDE;
+    long position = snap.position[i];
+    long steps = position - reported[i];
+    if (steps > 32767) {
+      steps = 32767;
+    }
+    else if (steps < -32768) {
+      steps = -32768;
+    }
+    delta[i] = steps;
+    unsigned char button = snap.button[i] == 0x01;
+    if (steps || button != buttons[i]) {
+      changed |= 1 << i;
+    }
+    // Only taken as reported if the block is read, see end()
+    latched[i] = button;
+    for (unsigned char b = 0; b < 4; b++) {
+      block[ROTARY_REG_POSITION + b] = (unsigned long)position >> (8 * b);
+    }
+    block[ROTARY_REG_DELTA] = (unsigned int)steps;
+    block[ROTARY_REG_DELTA + 1] = (unsigned int)steps >> 8;
+    block[ROTARY_REG_BUTTON] = button;
+  }
+  image[ROTARY_REG_STATUS] = changed;
+  status = changed;
+}
+
+/*
+ * Starts a transaction at the given register. Latches the whole map.
+ */
+void RotaryCoprocessor::begin(unsigned char address) {
+  if (active) {
+    // Repeated start: the transaction carries on with a new pointer
+    pointer = address;
+    return;
+  }
+  active = true;
+  touched = 0;
+  pointer = address;
+  latch();
+}
+
+/*
+ * Next byte of a read, from the map latched by begin(). Reads past the
+ * end of the map return 0.
+ */
+unsigned char RotaryCoprocessor::read() {
+  if (pointer >= ROTARY_COPRO_MAP) {
+    return 0;
+  }
+  if (pointer >= ROTARY_REG_ENCODERS) {
+    touched |= 1 << ((pointer - ROTARY_REG_ENCODERS) / ROTARY_COPRO_STRIDE);
+  }
+  return image[pointer++];
+}
+
+/*
+ * Next byte of a write. Only the interrupt mask and control registers
+ * are writable; other bytes are ignored.
+ */
+void RotaryCoprocessor::write(unsigned char value) {
+  if (pointer == ROTARY_REG_INT_MASK) {
+    mask = value;
+  }
+  else if (pointer == ROTARY_REG_CONTROL && (value & ROTARY_CONTROL_RESET)) {
+    // resetPosition() turns interrupts back on, so leave it to service()
+    resetPending = true;
+  }
+  if (pointer < ROTARY_COPRO_MAP) {
+    pointer++;
+  }
+}
+
+/*
+ * Ends the transaction. The deltas and buttons of the blocks that were
+ * read are consumed and their status bits cleared. Blocks left unread
+ * stay flagged.
+ */
+void RotaryCoprocessor::end() {
+  if (!active) {
+    return;
+  }
+  for (unsigned char i = 0; i < ROTARY_GROUP_SIZE; i++) {
+    if (touched & (1 << i)) {
+      reported[i] += delta[i];
+      buttons[i] = latched[i];
+      if (delta[i] == 32767 || delta[i] == -32768) {
+        // Saturated, more to report next time
+        continue;
+      }
+      status &= ~(1 << i);
+    }
+  }
+  active = false;
+}
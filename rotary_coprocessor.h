@@ -0,0 +1,91 @@
+/*
+ * Encoder co-processor: a small MCU decodes a group of encoders and a
+ * main controller reads them all over I2C or SPI in one burst.
+ *
+ * The encoders are exposed through a register map. Every transaction
+ * starts by setting the register pointer, which auto-increments with each
+ * byte read or written. Multi-byte values are little-endian.
+ *
+ *   0x00  ID, always ROTARY_COPRO_ID
+ *   0x01  map version
+ *   0x02  number of encoders
+ *   0x03  status: bit n is set while encoder n has changed since its
+ *         block was last read
+ *   0x04  interrupt mask (read/write): status bits that pull the
+ *         interrupt line low, all by default
+ *   0x05  control (write): 1 resets every position to 0, at the next
+ *         service()
+ *   0x08  encoder 0 block, then one block of ROTARY_COPRO_STRIDE bytes
+ *         per encoder:
+ *           +0  position, 4 bytes
+ *           +4  delta: steps since the block was last read, 2 bytes,
+ *               saturating; any excess is reported by the next read
+ *           +6  button: 1 while pressed
+ *           +7  reserved
+ *
+ * The whole map is latched when a transaction starts, so a burst read
+ * gives every encoder as of one instant. Reading any byte of a block
+ * acknowledges it: when the transaction ends its delta is taken as
+ * consumed and its status bit is cleared.
+ */
+
+#ifndef rotary_coprocessor_h
+#define rotary_coprocessor_h
+
+#include "rotary_group.h"
+
+#define ROTARY_COPRO_ID 0x52
+#define ROTARY_COPRO_VERSION 1
+
+// Register addresses.
+#define ROTARY_REG_ID 0x00
+#define ROTARY_REG_VERSION 0x01
+#define ROTARY_REG_COUNT 0x02
+#define ROTARY_REG_STATUS 0x03
+#define ROTARY_REG_INT_MASK 0x04
+#define ROTARY_REG_CONTROL 0x05
+#define ROTARY_REG_ENCODERS 0x08
+
+// Offsets within an encoder block, and the size of a block.
+#define ROTARY_REG_POSITION 0
+#define ROTARY_REG_DELTA 4
+#define ROTARY_REG_BUTTON 6
+#define ROTARY_COPRO_STRIDE 8
+
+// Size of the register map.
+#define ROTARY_COPRO_MAP (ROTARY_REG_ENCODERS + ROTARY_GROUP_SIZE * ROTARY_COPRO_STRIDE)
+
+// Control register bits.
+#define ROTARY_CONTROL_RESET 0x01
+
+class RotaryCoprocessor
+{
+  public:
+    RotaryCoprocessor(RotaryGroup &);
+    void setInterruptPin(signed char);
+    void service();
+    // Bus side, called from the I2C or SPI handlers
+    void begin(unsigned char);
+    unsigned char read();
+    void write(unsigned char);
+    void end();
+  private:
+    void latch();
+    RotaryGroup &group;
+    unsigned char image[ROTARY_COPRO_MAP];
+    long reported[ROTARY_GROUP_SIZE];
+    int delta[ROTARY_GROUP_SIZE];
+    // Buttons as last read by the master, and as latched for the
+    // transaction in progress
+    unsigned char buttons[ROTARY_GROUP_SIZE];
+    unsigned char latched[ROTARY_GROUP_SIZE];
+    volatile unsigned char status;
+    unsigned char mask;
+    unsigned char pointer;
+    unsigned char touched;
+    bool active;
+    volatile bool resetPending;
+    signed char interruptPin;
+};
+
+#endif
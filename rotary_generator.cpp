@@ -0,0 +1,266 @@
+/*
+ * Quadrature signal generator.
+ *
+ * Injected bounce imitates worn contacts: for a few ticks after an edge,
+ * the pin that changed may flip back to its old level and forth again,
+ * at random. This applies to A, B and the button, not the index. Only
+ * the pin that changed bounces, so the outputs still never jump two codes
+ * at once, and a correct decoder must count exactly the steps generated.
+ *
+ * tick() runs in a timer interrupt, so it keeps the index phase as a
+ * counter that wraps along with the position rather than dividing.
+ */
+
+#include "rotary_generator.h"
+
+// Clockwise Gray sequence as (pin2 << 1) | pin1.
+static const unsigned char sequence[4] = {0, 2, 3, 1};
+
+// One quarter-step in the 16.16 phase accumulator.
+#define ROTARY_GEN_ONE 0x10000L
+
+RotaryGenerator::RotaryGenerator(signed char a, signed char b) {
+  pin1 = a;
+  pin2 = b;
+  indexPin = ROTARY_NO_PIN;
+  buttonPin = ROTARY_NO_PIN;
+  rate = 1;
+  indexPeriod = 0;
+  indexPhase = 0;
+  bounceTicks = 0;
+  bounceChance = 0;
+  bounceLeft = 0;
+  bounceMask = 0;
+  noise = 0xace1;
+  increment = 0;
+  phase = 0;
+  quarter = 0;
+  target = 0;
+  targeting = false;
+  buttonDown = false;
+  stable = settled();
+  output = stable;
+}
+
+/*
+ * Sets the rate, in Hz, at which tick() will be called and drives the
+ * outputs to their starting levels: 00 with the button released.
+ */
+void RotaryGenerator::begin(unsigned long tickRate) {
+  rate = tickRate;
+  stable = settled();
+  output = stable;
+  const signed char pins[4] = {pin1, pin2, buttonPin, indexPin};
+  for (unsigned char i = 0; i < 4; i++) {
+    if (pins[i] != ROTARY_NO_PIN) {
+      pinMode(pins[i], OUTPUT);
+      digitalWrite(pins[i], (output >> i) & 1);
+    }
+  }
+}
+
+/*
+ * Adds an index output, high for the quarter-step at every multiple of
+ * the given number of quarter-steps, ie. once per revolution. Call before
+ * begin().
+ */
+void RotaryGenerator::setIndex(signed char pin, unsigned int quartersPerRevolution) {
+  indexPin = pin;
+  indexPeriod = quartersPerRevolution;
+  indexPhase = 0;
+  if (indexPeriod) {
+    long phase = quarter % (long)indexPeriod;
+    indexPhase = phase < 0 ? phase + indexPeriod : phase;
+  }
+}
+
+/*
+ * Adds a button output, low while pressed. Call before begin().
+ */
+void RotaryGenerator::setButton(signed char pin) {
+  buttonPin = pin;
+}
+
+/*
+ * Makes each edge bounce for the given number of ticks, flipping back
+ * with the given chance in 256 on each of them. 0 ticks turns bounce off.
+ */
+void RotaryGenerator::setBounce(unsigned char ticks, unsigned char chance) {
+  noInterrupts();
+  bounceTicks = ticks;
+  bounceChance = chance;
+  interrupts();
+}
+
+/*
+ * Converts a speed in quarter-steps per second to the increment per tick.
+ * Speeds beyond one quarter-step per tick are limited to that, and speeds
+ * other than 0 below one quarter-step per 65536 ticks are raised to that.
+ */
+long RotaryGenerator::step(long quartersPerSecond) {
+  long result = ((long long)quartersPerSecond << 16) / (long)rate;
+  if (!result && quartersPerSecond) {
+    // Too slow for the accumulator, but it must still get somewhere
+    result = quartersPerSecond > 0 ? 1 : -1;
+  }
+  else if (result > ROTARY_GEN_ONE) {
+    result = ROTARY_GEN_ONE;
+  }
+  else if (result < -ROTARY_GEN_ONE) {
+    result = -ROTARY_GEN_ONE;
+  }
+  return result;
+}
+
+/*
+ * Turns at the given speed in quarter-steps per second, clockwise if
+ * positive, until told otherwise. See step() for the limits.
+ */
+void RotaryGenerator::setVelocity(long quartersPerSecond) {
+  long next = step(quartersPerSecond);
+  noInterrupts();
+  targeting = false;
+  increment = next;
+  interrupts();
+}
+
+/*
+ * Turns towards the given position at the given speed in quarter-steps
+ * per second, and stops there. A speed of 0 stops where it is. The
+ * direction, speed and target change together, so tick() never sees a
+ * new speed with the old target.
+ */
+void RotaryGenerator::moveTo(long position, long quartersPerSecond) {
+  if (quartersPerSecond < 0) {
+    quartersPerSecond = -quartersPerSecond;
+  }
+  if (!quartersPerSecond) {
+    setVelocity(0);
+    return;
+  }
+  long speed = step(quartersPerSecond);
+  noInterrupts();
+  target = position;
+  targeting = position != quarter;
+  increment = !targeting ? 0 : position < quarter ? -speed : speed;
+  interrupts();
+}
+
+/*
+ * Presses or releases the button. The edge bounces like the others.
+ */
+void RotaryGenerator::press(bool pressed) {
+  buttonDown = pressed;
+}
+
+/*
+ * Returns true while the outputs are turning.
+ */
+bool RotaryGenerator::moving() {
+  return increment != 0;
+}
+
+/*
+ * Returns the number of quarter-steps generated, clockwise positive.
+ */
+long RotaryGenerator::position() {
+  noInterrupts();
+  long result = quarter;
+  interrupts();
+  return result;
+}
+
+/*
+ * Returns the levels currently driven, as ROTARY_GEN_* bits. An interrupt
+ * handler that needs more speed than digitalWrite() gives can construct
+ * its generator with pins of ROTARY_NO_PIN and write these to a port
+ * itself.
+ */
+unsigned char RotaryGenerator::levels() {
+  return output;
+}
+
+unsigned char RotaryGenerator::settled() {
+  unsigned char result = sequence[quarter & 3];
+  if (!buttonDown) {
+    result |= ROTARY_GEN_BUTTON;
+  }
+  if (indexPeriod && indexPhase == 0) {
+    result |= ROTARY_GEN_INDEX;
+  }
+  return result;
+}
+
+unsigned char RotaryGenerator::noiseByte() {
+  // 16-bit xorshift, the same on AVR and wider ints
+  noise = (noise ^ noise << 7) & 0xffff;
+  noise ^= noise >> 9;
+  noise = (noise ^ noise << 8) & 0xffff;
+  return noise;
+}
+
+/*
+ * Advances the generator by one tick. Call from a timer interrupt at the
+ * rate given to begin().
+ */
+void RotaryGenerator::tick() {
+  if (increment) {
+    phase += increment;
+    if (phase >= ROTARY_GEN_ONE) {
+      phase -= ROTARY_GEN_ONE;
+      quarter++;
+      if (++indexPhase >= indexPeriod) {
+        indexPhase = 0;
+      }
+    }
+    else if (phase <= -ROTARY_GEN_ONE) {
+      phase += ROTARY_GEN_ONE;
+      quarter--;
+      if (indexPhase == 0) {
+        indexPhase = indexPeriod;
+      }
+      if (indexPhase) {
+        indexPhase--;
+      }
+    }
+    if (targeting && quarter == target) {
+      targeting = false;
+      increment = 0;
+      phase = 0;
+    }
+  }
+  unsigned char want = settled();
+  if (want != stable) {
+    if (output != stable) {
+      // Still bouncing from the last edge: settle it first, so that the
+      // pins never change two at a time
+      write(stable);
+    }
+    // The index comes from an optical track and does not bounce
+    bounceMask = (want ^ stable) & ~ROTARY_GEN_INDEX;
+    bounceLeft = bounceTicks;
+    stable = want;
+  }
+  else if (bounceLeft) {
+    bounceLeft--;
+    if (bounceLeft && noiseByte() < bounceChance) {
+      // Flip the pin that last changed back to its old level
+      want = output == stable ? stable ^ bounceMask : stable;
+    }
+  }
+  write(want);
+}
+
+void RotaryGenerator::write(unsigned char next) {
+  unsigned char changed = next ^ output;
+  output = next;
+  if (!changed) {
+    return;
+  }
+  const signed char pins[4] = {pin1, pin2, buttonPin, indexPin};
+  for (unsigned char i = 0; i < 4; i++) {
+    if ((changed >> i) & 1 && pins[i] != ROTARY_NO_PIN) {
+      digitalWrite(pins[i], (next >> i) & 1);
+    }
+  }
+}
@@ -0,0 +1,78 @@
+/*
+ * Quadrature signal generator, the inverse of process().
+ *
+ * Drives A/B outputs, and optionally an index pulse and a button, for
+ * testing decoders and downstream devices at controlled rates. Call
+ * tick() from a timer interrupt at a fixed rate. A phase accumulator
+ * advances by the set velocity each tick, and each time it crosses a
+ * whole quarter-step the outputs move one code along the same Gray
+ * sequence the decoder expects, 00 > 10 > 11 > 01 (pin 2, pin 1) for
+ * clockwise. At most one transition is made per tick, so the tick rate is
+ * the fastest possible quarter-step rate.
+ *
+ * Positions and velocities are in quarter-steps, ie. transitions. A
+ * detent is two of them in half-step mode and four in full-step mode.
+ */
+
+#ifndef rotary_generator_h
+#define rotary_generator_h
+
+#include "rotary.h"
+
+// Bits of levels(), as they are driven on the pins.
+#define ROTARY_GEN_PIN1 0x01
+#define ROTARY_GEN_PIN2 0x02
+#define ROTARY_GEN_BUTTON 0x04
+#define ROTARY_GEN_INDEX 0x08
+
+class RotaryGenerator
+{
+  public:
+    RotaryGenerator(signed char, signed char);
+    void begin(unsigned long);
+    void setIndex(signed char, unsigned int);
+    void setButton(signed char);
+    void setBounce(unsigned char, unsigned char);
+    // Motion
+    void setVelocity(long);
+    void moveTo(long, long);
+    void press(bool);
+    bool moving();
+    long position();
+    // Timer interrupt side
+    void tick();
+    unsigned char levels();
+  private:
+    void write(unsigned char);
+    long step(long);
+    unsigned char settled();
+    unsigned char noiseByte();
+    signed char pin1;
+    signed char pin2;
+    signed char indexPin;
+    signed char buttonPin;
+    unsigned long rate;
+    // Quarter-steps per index pulse, and the position within that
+    unsigned int indexPeriod;
+    unsigned int indexPhase;
+    // Bounce: ticks of chatter after each edge, and the chance in 256 of
+    // the changed pin flipping back on each of them
+    unsigned char bounceTicks;
+    unsigned char bounceChance;
+    unsigned char bounceLeft;
+    unsigned char bounceMask;
+    unsigned int noise;
+    // Levels without bounce, and as driven
+    unsigned char stable;
+    unsigned char output;
+    // Quarter-steps per tick in 16.16 fixed point, and the fraction
+    // accumulated towards the next one
+    volatile long increment;
+    long phase;
+    volatile long quarter;
+    volatile long target;
+    volatile bool targeting;
+    volatile bool buttonDown;
+};
+
+#endif
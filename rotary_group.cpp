@@ -0,0 +1,119 @@
+/*
+ * Groups of encoders that are read together.
+ *
+ * Every encoder bumps its change counter whenever its position changes.
+ * snapshot() reads all the counters, copies all the positions, then reads
+ * the counters again. If none moved, no interrupt handler ran in between
+ * and the copy is coherent. Otherwise it tries again, and only after
+ * ROTARY_SNAPSHOT_RETRIES busy attempts does it hold interrupts off, for
+ * no longer than it takes to copy the positions.
+ */
+
+#include "Arduino.h"
+#include "rotary_group.h"
+
+RotaryGroup::RotaryGroup() {
+  count = 0;
+  cursor = 0;
+}
+
+/*
+ * Adds an encoder to the group. Returns its index in snapshots, or -1 if
+ * the group is full.
+ */
+signed char RotaryGroup::add(Rotary &encoder) {
+  return attach(encoder, false);
+}
+
+/*
+ * Same as add(), for encoders constructed with a button pin. Snapshots
+ * then include the button level.
+ */
+signed char RotaryGroup::addWithButton(Rotary &encoder) {
+  return attach(encoder, true);
+}
+
+signed char RotaryGroup::attach(Rotary &encoder, bool button) {
+  if (count >= ROTARY_GROUP_SIZE) {
+    return -1;
+  }
+  encoders[count] = &encoder;
+  buttons[count] = button;
+  return count++;
+}
+
+/*
+ * Number of encoders in the group.
+ */
+unsigned char RotaryGroup::size() {
+  return count;
+}
+
+/*
+ * Copies the position of every encoder in the group as of one instant,
+ * followed by the button levels.
+ */
+void RotaryGroup::snapshot(RotarySnapshot &snap) {
+  unsigned char before[ROTARY_GROUP_SIZE];
+  snap.count = count;
+  for (unsigned char attempt = 0; ; attempt++) {
+    bool locked = attempt == ROTARY_SNAPSHOT_RETRIES;
+    if (locked) {
+      noInterrupts();
+    }
+    for (unsigned char i = 0; i < count; i++) {
+      before[i] = encoders[i]->changes;
+    }
+    for (unsigned char i = 0; i < count; i++) {
+      snap.position[i] = encoders[i]->position;
+    }
+    bool stable = true;
+    for (unsigned char i = 0; i < count; i++) {
+      if (encoders[i]->changes != before[i]) {
+        stable = false;
+      }
+    }
+    if (locked) {
+      interrupts();
+    }
+    if (stable || locked) {
+      break;
+    }
+  }
+  for (unsigned char i = 0; i < count; i++) {
+    snap.button[i] = buttons[i] ? encoders[i]->readButton() : 0;
+  }
+}
+
+/*
+ * Resets the position of every encoder in the group to 0.
+ */
+void RotaryGroup::resetPositions() {
+  for (unsigned char i = 0; i < count; i++) {
+    encoders[i]->resetPosition();
+  }
+}
+
+/*
+ * Services the encoders round-robin, calling poll() on each, until every
+ * encoder has had its turn or budgetMicros have passed. The next call
+ * starts with the first encoder that missed out, so all of them are
+ * serviced in turn however small the budget. At least one encoder is
+ * serviced per call. Returns the number of encoders deferred to the
+ * next call.
+ */
+unsigned char RotaryGroup::processAll(unsigned int budgetMicros) {
+  unsigned long start = micros();
+  unsigned char serviced = 0;
+  while (serviced < count) {
+    if (serviced && micros() - start >= budgetMicros) {
+      break;
+    }
+    encoders[cursor]->poll();
+    if (++cursor == count) {
+      cursor = 0;
+    }
+    serviced++;
+  }
+  return count - serviced;
+}
@@ -0,0 +1,48 @@
+/*
+ * Groups of encoders that are read together.
+ *
+ * snapshot() copies the positions and buttons of every encoder in the
+ * group as they stood at a single instant, even while interrupt handlers
+ * keep processing the encoders. processAll() services the encoders within
+ * a time budget.
+ */
+
+#ifndef rotary_group_h
+#define rotary_group_h
+
+#include "rotary.h"
+
+// Number of encoders one group can hold.
+#define ROTARY_GROUP_SIZE 8
+
+// Lock-free attempts before snapshot() briefly holds interrupts off.
+#define ROTARY_SNAPSHOT_RETRIES 4
+
+// Positions and button levels of a group, in the order they were added.
+// Buttons read BUTTON_PRESSED or BUTTON_RELEASED, or 0 for encoders
+// added without one.
+struct RotarySnapshot {
+  unsigned char count;
+  long position[ROTARY_GROUP_SIZE];
+  unsigned char button[ROTARY_GROUP_SIZE];
+};
+
+class RotaryGroup
+{
+  public:
+    RotaryGroup();
+    signed char add(Rotary &);
+    signed char addWithButton(Rotary &);
+    unsigned char size();
+    void snapshot(RotarySnapshot &);
+    void resetPositions();
+    unsigned char processAll(unsigned int);
+  private:
+    signed char attach(Rotary &, bool);
+    Rotary *encoders[ROTARY_GROUP_SIZE];
+    bool buttons[ROTARY_GROUP_SIZE];
+    unsigned char count;
+    unsigned char cursor;
+};
+
+#endif
@@ -0,0 +1,222 @@
+/*
+ * Block-buffered event journal for SD cards and flash.
+ *
+ * Block n of the journal goes to storage block n % blocks(), so the
+ * storage is used as a ring and the oldest blocks are overwritten once
+ * it is full. Each block carries its sequence number, its record count
+ * and a checksum. begin() scans the storage for the newest valid block
+ * and carries on with the block after it. Events still in RAM at a power
+ * loss are lost, so sync() bounds how many that can be. It writes the
+ * partly filled block as it stands and starts a new one, rather than
+ * rewriting the block later: a block once written is never written again
+ * until the ring comes round to it, so a power loss during a write can
+ * only damage the block being written, never events already synced. The
+ * cost is write amplification, and ring space taken by short blocks.
+ *
+ * log(), idle() and sync() must all be called from the same context,
+ * usually loop().
+ */
+
+#include "Arduino.h"
+#include "rotary_journal.h"
+
+#define JOURNAL_MAGIC0 'R'
+#define JOURNAL_MAGIC1 'J'
+#define JOURNAL_COUNT 6
+#define JOURNAL_CHECK 7
+
+static unsigned char journalChecksum(const unsigned char *block) {
+  unsigned char sum = 0;
+  for (unsigned int i = 0; i < ROTARY_JOURNAL_BLOCK; i++) {
+    if (i != JOURNAL_CHECK) {
+      sum += block[i];
+    }
+  }
+  return sum;
+}
+
+static void writeLong(unsigned char *bytes, unsigned long value) {
+  for (unsigned char i = 0; i < 4; i++) {
+    bytes[i] = value >> (8 * i);
+  }
+}
+
+static unsigned long readLong(const unsigned char *bytes) {
+  unsigned long value = 0;
+  for (unsigned char i = 0; i < 4; i++) {
+    value |= (unsigned long)bytes[i] << (8 * i);
+  }
+  return value;
+}
+
+RotaryJournal::RotaryJournal(RotaryJournalStorage &target) : storage(target) {
+  current = 0;
+  sequence = 0;
+  capacity = 0;
+  logged = 0;
+  written = 0;
+  lost = 0;
+  for (unsigned char i = 0; i < ROTARY_JOURNAL_BUFFERS; i++) {
+    pending[i] = false;
+  }
+}
+
+/*
+ * Scans the storage and resumes after the newest block found. Returns
+ * false if the storage has no blocks.
+ */
+bool RotaryJournal::begin() {
+  capacity = storage.blocks();
+  if (!capacity) {
+    return false;
+  }
+  bool found = false;
+  unsigned long newest = 0;
+  unsigned char *scan = buffers[0];
+  for (unsigned long b = 0; b < capacity; b++) {
+    if (storage.readBlock(b, scan) && validBlock(scan)) {
+      unsigned long number = blockSequence(scan);
+      if (!found || number > newest) {
+        found = true;
+        newest = number;
+      }
+    }
+  }
+
+  current = 0;
+  sequence = found ? newest + 1 : 0;
+  startBlock(0);
+  return true;
+}
+
+void RotaryJournal::startBlock(unsigned char buffer) {
+  unsigned char *block = buffers[buffer];
+  memset(block, 0, ROTARY_JOURNAL_BLOCK);
+  block[0] = JOURNAL_MAGIC0;
+  block[1] = JOURNAL_MAGIC1;
+  writeLong(block + 2, sequence);
+}
+
+/*
+ * Appends an event to the current block. Returns false, and counts the
+ * event as dropped, if every buffer is full and waiting for idle().
+ */
+bool RotaryJournal::log(const RotaryEvent &event) {
+  if (buffers[current][JOURNAL_COUNT] == ROTARY_JOURNAL_RECORDS) {
+    unsigned char next = (current + 1) % ROTARY_JOURNAL_BUFFERS;
+    if (pending[next]) {
+      lost++;
+      return false;
+    }
+    current = next;
+    sequence++;
+    startBlock(current);
+  }
+  unsigned char *block = buffers[current];
+  unsigned char *record = block + ROTARY_JOURNAL_HEADER + block[JOURNAL_COUNT] * ROTARY_JOURNAL_RECORD;
+  writeLong(record, event.time);
+  record[4] = event.source;
+  record[5] = event.event;
+  logged++;
+  if (++block[JOURNAL_COUNT] == ROTARY_JOURNAL_RECORDS) {
+    pending[current] = true;
+  }
+  return true;
+}
+
+bool RotaryJournal::writeBuffer(unsigned char buffer) {
+  // No storage until begin() has succeeded
+  if (!capacity) {
+    return false;
+  }
+  unsigned char *block = buffers[buffer];
+  block[JOURNAL_CHECK] = journalChecksum(block);
+  if (!storage.writeBlock(blockSequence(block) % capacity, block)) {
+    return false;
+  }
+  written += ROTARY_JOURNAL_BLOCK;
+  return true;
+}
+
+/*
+ * Writes every full block, oldest first. Call when the sketch can afford
+ * the stall. Returns false if the storage failed; the blocks stay queued.
+ */
+bool RotaryJournal::idle() {
+  for (unsigned char k = 1; k <= ROTARY_JOURNAL_BUFFERS; k++) {
+    unsigned char buffer = (current + k) % ROTARY_JOURNAL_BUFFERS;
+    if (pending[buffer]) {
+      if (!writeBuffer(buffer)) {
+        return false;
+      }
+      pending[buffer] = false;
+    }
+  }
+  return true;
+}
+
+/*
+ * Same as idle(), then also writes the partly filled block, if it has any
+ * events, so they survive a power loss. The block is written as it stands
+ * and the next events go in a new block.
+ */
+bool RotaryJournal::sync() {
+  if (!idle()) {
+    return false;
+  }
+  unsigned char count = buffers[current][JOURNAL_COUNT];
+  if (!count || count == ROTARY_JOURNAL_RECORDS) {
+    return true;
+  }
+  if (!writeBuffer(current)) {
+    return false;
+  }
+  sequence++;
+  startBlock(current);
+  return true;
+}
+
+/*
+ * Bytes of events passed to log().
+ */
+unsigned long RotaryJournal::bytesLogged() {
+  return logged * ROTARY_JOURNAL_RECORD;
+}
+
+/*
+ * Bytes written to storage, including partial blocks written by sync().
+ */
+unsigned long RotaryJournal::bytesWritten() {
+  return written;
+}
+
+/*
+ * Events dropped because all buffers were full.
+ */
+unsigned long RotaryJournal::dropped() {
+  return lost;
+}
+
+/*
+ * True if a block read from storage was written by the journal intact.
+ */
+bool RotaryJournal::validBlock(const unsigned char *block) {
+  return block[0] == JOURNAL_MAGIC0 && block[1] == JOURNAL_MAGIC1 &&
+         block[JOURNAL_COUNT] <= ROTARY_JOURNAL_RECORDS &&
+         block[JOURNAL_CHECK] == journalChecksum(block);
+}
+
+unsigned long RotaryJournal::blockSequence(const unsigned char *block) {
+  return readLong(block + 2);
+}
+
+unsigned char RotaryJournal::blockRecords(const unsigned char *block) {
+  return block[JOURNAL_COUNT];
+}
+
+void RotaryJournal::readRecord(const unsigned char *block, unsigned char index, RotaryEvent &event) {
+  const unsigned char *record = block + ROTARY_JOURNAL_HEADER + index * ROTARY_JOURNAL_RECORD;
+  event.time = readLong(record);
+  event.source = record[4];
+  event.event = record[5];
+}
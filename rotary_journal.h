@@ -0,0 +1,67 @@
+/*
+ * Block-buffered event journal for SD cards and flash.
+ *
+ * Events are collected in RAM in blocks of ROTARY_JOURNAL_BLOCK bytes and
+ * only whole blocks are written, when the application says it is idle.
+ * Writing each event as it happens would stall the sketch for a full
+ * block write every time.
+ */
+
+#ifndef rotary_journal_h
+#define rotary_journal_h
+
+#include "rotary.h"
+
+// Size of one storage block, and of each RAM buffer.
+#define ROTARY_JOURNAL_BLOCK 512
+// RAM buffers. One can fill while the others wait for idle().
+#define ROTARY_JOURNAL_BUFFERS 2
+// Block header: magic (2), sequence number (4), record count (1), checksum (1).
+#define ROTARY_JOURNAL_HEADER 8
+// Record: time (4), source (1), event (1).
+#define ROTARY_JOURNAL_RECORD 6
+#define ROTARY_JOURNAL_RECORDS ((ROTARY_JOURNAL_BLOCK - ROTARY_JOURNAL_HEADER) / ROTARY_JOURNAL_RECORD)
+
+// Block device the journal writes to, eg. a file on an SD card or a
+// region of flash. Blocks are numbered from 0 to blocks() - 1.
+class RotaryJournalStorage
+{
+  public:
+    virtual ~RotaryJournalStorage() {}
+    virtual unsigned long blocks() = 0;
+    virtual bool readBlock(unsigned long, unsigned char *) = 0;
+    virtual bool writeBlock(unsigned long, const unsigned char *) = 0;
+};
+
+class RotaryJournal
+{
+  public:
+    RotaryJournal(RotaryJournalStorage &);
+    bool begin();
+    bool log(const RotaryEvent &);
+    bool idle();
+    bool sync();
+    // Counters for write amplification, ie. bytesWritten() / bytesLogged()
+    unsigned long bytesLogged();
+    unsigned long bytesWritten();
+    unsigned long dropped();
+    // Reading blocks back
+    static bool validBlock(const unsigned char *);
+    static unsigned long blockSequence(const unsigned char *);
+    static unsigned char blockRecords(const unsigned char *);
+    static void readRecord(const unsigned char *, unsigned char, RotaryEvent &);
+  private:
+    void startBlock(unsigned char);
+    bool writeBuffer(unsigned char);
+    RotaryJournalStorage &storage;
+    unsigned char buffers[ROTARY_JOURNAL_BUFFERS][ROTARY_JOURNAL_BLOCK];
+    bool pending[ROTARY_JOURNAL_BUFFERS];
+    unsigned char current;
+    unsigned long sequence;
+    unsigned long capacity;
+    unsigned long logged;
+    unsigned long written;
+    unsigned long lost;
+};
+
+#endif
@@ -0,0 +1,145 @@
+/*
+ * Two-lane event delivery.
+ *
+ * The priority lane is a ring written only by the producer (head) and
+ * read only by the consumer (tail), so neither side needs a lock. The
+ * rotation lane has no queue to overflow: the producer only ever adds to
+ * a source's running count, and the consumer remembers how much of it
+ * has been handed out, the same way readPosition() works.
+ */
+
+#include "Arduino.h"
+#include "rotary_lanes.h"
+
+#define ROTARY_LANE_MASK (ROTARY_LANE_SIZE - 1)
+
+// Most steps handed out in one read, so that they fit an int on AVR.
+#define ROTARY_LANE_MAX_STEPS 32767
+
+RotaryEventLanes::RotaryEventLanes() {
+  head = 0;
+  tail = 0;
+  lost = 0;
+  cursor = 0;
+  for (unsigned char i = 0; i < ROTARY_LANE_SOURCES; i++) {
+    total[i] = 0;
+    stamp[i] = 0;
+    taken[i] = 0;
+  }
+}
+
+/*
+ * Posts an event from the producer, eg. the interrupt handler. Steps
+ * (DIR_CW or DIR_CCW) are added to their source's rotation; anything
+ * else goes into the priority lane. Returns false if the priority lane
+ * was full, or the source of a step is out of range, and the event was
+ * dropped.
+ */
+bool RotaryEventLanes::post(const RotaryEvent &event) {
+  if (event.event & (DIR_CW | DIR_CCW)) {
+    if (event.source >= ROTARY_LANE_SOURCES) {
+      return false;
+    }
+    rotate(event);
+    return true;
+  }
+  unsigned char at = head;
+  unsigned char next = (at + 1) & ROTARY_LANE_MASK;
+  if (next == tail) {
+    lost = lost + 1;
+    return false;
+  }
+  lane[at] = event;
+  ROTARY_BARRIER();
+  head = next;
+  return true;
+}
+
+/*
+ * Same as above, stamping the event with micros().
+ */
+bool RotaryEventLanes::post(unsigned char source, unsigned char event) {
+  RotaryEvent entry = {micros(), source, event};
+  return post(entry);
+}
+
+void RotaryEventLanes::rotate(const RotaryEvent &event) {
+  unsigned char source = event.source;
+  total[source] = total[source] + (event.event & DIR_CW ? 1 : -1);
+  stamp[source] = event.time;
+}
+
+/*
+ * Takes the next event for the consumer. Waiting button and gesture
+ * events come first, oldest first, with steps set to 0. Then each source
+ * whose rotation moved since it was last read, in turn, as one event:
+ * DIR_CW or DIR_CCW, stamped with the time of its latest step, with steps
+ * set to the signed number of steps (negative for anti-clockwise).
+ * Returns false if there is nothing to read.
+ */
+bool RotaryEventLanes::read(RotaryEvent &event, int &steps) {
+  unsigned char at = tail;
+  if (at != head) {
+    ROTARY_BARRIER();
+    event = lane[at];
+    ROTARY_BARRIER();
+    tail = (at + 1) & ROTARY_LANE_MASK;
+    steps = 0;
+    return true;
+  }
+  for (unsigned char n = 0; n < ROTARY_LANE_SOURCES; n++) {
+    unsigned char source = cursor;
+    cursor = (cursor + 1) % ROTARY_LANE_SOURCES;
+    noInterrupts();
+    long count = total[source];
+    unsigned long time = stamp[source];
+    interrupts();
+    long moved = count - taken[source];
+    if (!moved) {
+      continue;
+    }
+    // Anything beyond one int's worth is left for the next read
+    if (moved > ROTARY_LANE_MAX_STEPS) {
+      moved = ROTARY_LANE_MAX_STEPS;
+    }
+    else if (moved < -ROTARY_LANE_MAX_STEPS) {
+      moved = -ROTARY_LANE_MAX_STEPS;
+    }
+    taken[source] += moved;
+    event.time = time;
+    event.source = source;
+    event.event = moved > 0 ? DIR_CW : DIR_CCW;
+    steps = moved;
+    return true;
+  }
+  return false;
+}
+
+/*
+ * Returns true if read() has something to deliver.
+ */
+bool RotaryEventLanes::pending() {
+  if (tail != head) {
+    return true;
+  }
+  for (unsigned char source = 0; source < ROTARY_LANE_SOURCES; source++) {
+    noInterrupts();
+    long count = total[source];
+    interrupts();
+    if (count != taken[source]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+ * Returns the number of button and gesture events dropped because the
+ * priority lane was full.
+ */
+unsigned long RotaryEventLanes::dropped() {
+  noInterrupts();
+  unsigned long result = lost;
+  interrupts();
+  return result;
+}
@@ -0,0 +1,49 @@
+/*
+ * Two-lane event delivery: button events overtake rotation.
+ *
+ * An interrupt handler posts every event it produces. Button and gesture
+ * events (EVENT_CLICK, EVENT_HOLD, EVENT_PRESS or any other value without
+ * the DIR_CW or DIR_CCW bits) go into a small priority lane. Rotation is
+ * not queued at all: each source keeps a running count, and the consumer
+ * is handed the steps taken since it last looked, as one event. read()
+ * always drains the priority lane first, so a press is delivered on the
+ * next read however fast the encoders spin.
+ */
+
+#ifndef rotary_lanes_h
+#define rotary_lanes_h
+
+#include "rotary.h"
+
+// Button and gesture events the priority lane can hold, a power of two.
+// One slot is kept free, so one less than this can wait.
+#define ROTARY_LANE_SIZE 8
+// Sources, eg. encoders, whose rotation can be coalesced.
+#define ROTARY_LANE_SOURCES 8
+
+class RotaryEventLanes
+{
+  public:
+    RotaryEventLanes();
+    // Producer side
+    bool post(const RotaryEvent &);
+    bool post(unsigned char, unsigned char);
+    // Consumer side
+    bool read(RotaryEvent &, int &);
+    bool pending();
+    unsigned long dropped();
+  private:
+    void rotate(const RotaryEvent &);
+    // Priority lane
+    RotaryEvent lane[ROTARY_LANE_SIZE];
+    volatile unsigned char head;
+    volatile unsigned char tail;
+    volatile unsigned long lost;
+    // Rotation lane: running counts, and how much of them was delivered
+    volatile long total[ROTARY_LANE_SOURCES];
+    volatile unsigned long stamp[ROTARY_LANE_SOURCES];
+    long taken[ROTARY_LANE_SOURCES];
+    unsigned char cursor;
+};
+
+#endif
@@ -0,0 +1,167 @@
+/*
+ * Hardware quadrature counter.
+ *
+ * The timer counts up to ARR and wraps to 0, or down from 0 to ARR. With
+ * ARR at 0xffff the difference between two counter reads, taken as a
+ * signed 16-bit number, is the movement between them, however many times
+ * the counter wrapped, as long as it moved less than half the range. The
+ * update flag and interrupt are not used, so there is no race between an
+ * overflow and a read.
+ */
+
+#include "rotary_quad_timer.h"
+
+#ifdef HALF_STEP
+#define ROTARY_QT_SHIFT 1
+#else
+#define ROTARY_QT_SHIFT 2
+#endif
+#define ROTARY_QT_STEP (1L << ROTARY_QT_SHIFT)
+
+RotaryQuadTimer::RotaryQuadTimer(RotaryQuadTimerRegisters *registers) {
+  timer = registers;
+  filter = 0;
+  reverse = false;
+  lastCounter = 0;
+  quarters = 0;
+  steps = 0;
+  windowStart = 0;
+  windowQuarters = 0;
+  velocity = 0;
+}
+
+/*
+ * Sets the input filter, 0 (none) to 15, as the timer's ICxF field: the
+ * number of samples, and the sampling clock, for which an input has to be
+ * steady before an edge counts. Call before begin().
+ */
+void RotaryQuadTimer::setFilter(unsigned char value) {
+  filter = value & 0x0f;
+}
+
+/*
+ * Swaps clockwise and anti-clockwise. Call before begin().
+ */
+void RotaryQuadTimer::setReverse(bool reversed) {
+  reverse = reversed;
+}
+
+/*
+ * Puts the timer in encoder mode counting every edge of both inputs,
+ * clears the counter and starts it. The position starts at 0.
+ */
+void RotaryQuadTimer::begin() {
+  timer->CR1 = 0;
+  timer->DIER = 0;
+  timer->SMCR = ROTARY_QT_ENCODER_MODE;
+  timer->CCMR1 = ROTARY_QT_INPUT_DIRECT | (filter << 4) |
+                 (ROTARY_QT_INPUT_DIRECT << 8) | ((uint32_t)filter << 12);
+  timer->CCMR2 = 0;
+  // The timer counts up when input 1 leads, where Rotary counts clockwise
+  // when pin 2 leads, so input 1 is inverted unless reversed
+  timer->CCER = reverse ? 0 : ROTARY_QT_CCER_CC1P;
+  timer->PSC = 0;
+  timer->ARR = 0xffff;
+  // Load the prescaler and clear the counter, then the flag that sets
+  timer->EGR = ROTARY_QT_EGR_UG;
+  timer->CNT = 0;
+  timer->SR = 0;
+  noInterrupts();
+  lastCounter = 0;
+  quarters = 0;
+  windowStart = micros();
+  windowQuarters = 0;
+  velocity = 0;
+  interrupts();
+  timer->CR1 = ROTARY_QT_CR1_CEN;
+}
+
+/*
+ * Stops the counter. The position keeps its last value.
+ */
+void RotaryQuadTimer::end() {
+  service();
+  timer->CR1 = 0;
+}
+
+void RotaryQuadTimer::extend() {
+  uint16_t counter = timer->CNT;
+  quarters += (int16_t)(uint16_t)(counter - lastCounter);
+  lastCounter = counter;
+}
+
+/*
+ * Brings the 32-bit count up to date with the counter. Reading the
+ * position does this too; call it from a timer interrupt only if the
+ * position may otherwise go unread for 32767 quarter-steps, eg. every
+ * millisecond for speeds up to 32 million quarter-steps a second.
+ */
+void RotaryQuadTimer::service() {
+  noInterrupts();
+  extend();
+  unsigned long now = micros();
+  unsigned long elapsed = now - windowStart;
+  if (elapsed >= ROTARY_QT_VELOCITY_WINDOW) {
+    velocity = (long)((long long)(quarters - windowQuarters) * 1000000 / (long)elapsed);
+    windowStart = now;
+    windowQuarters = quarters;
+  }
+  interrupts();
+}
+
+/*
+ * Step count, as from Rotary: quarter-steps counted by the timer, in
+ * steps of the half-step or full-step mode. Like the state table, a step
+ * is counted when the encoder reaches the next detent, and only taken
+ * back when it reaches the one before, so it moves the same way in both
+ * directions. Only the counter at each call is seen, so a visit to the
+ * next detent and back between two calls does not count.
+ */
+long RotaryQuadTimer::readPosition() {
+  long count = readQuarters();
+  if (count >= (steps + 1) * ROTARY_QT_STEP) {
+    steps = count >> ROTARY_QT_SHIFT;
+  }
+  else if (count <= (steps - 1) * ROTARY_QT_STEP) {
+    steps = -(-count >> ROTARY_QT_SHIFT);
+  }
+  return steps;
+}
+
+/*
+ * Sets the position to 0.
+ */
+void RotaryQuadTimer::resetPosition() {
+  noInterrupts();
+  extend();
+  windowQuarters -= quarters;
+  quarters = 0;
+  interrupts();
+  steps = 0;
+}
+
+/*
+ * Quarter-steps counted, ie. every edge of both inputs, clockwise
+ * positive.
+ */
+long RotaryQuadTimer::readQuarters() {
+  service();
+  noInterrupts();
+  long result = quarters;
+  interrupts();
+  return result;
+}
+
+/*
+ * Speed in quarter-steps per second, positive clockwise, as from Rotary
+ * with recovery on. It is measured over at least
+ * ROTARY_QT_VELOCITY_WINDOW microseconds between calls to this or
+ * service(), so it lags by up to that long.
+ */
+long RotaryQuadTimer::readVelocity() {
+  service();
+  noInterrupts();
+  long result = velocity;
+  interrupts();
+  return result;
+}
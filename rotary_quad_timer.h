@@ -0,0 +1,92 @@
+/*
+ * Hardware quadrature counter: a timer in encoder mode decodes the pins.
+ *
+ * Timers on STM32 parts (and others with the same register layout) can
+ * count quadrature edges themselves, with an input filter and no CPU time
+ * per edge. RotaryQuadTimer sets such a timer up to count every edge of
+ * both inputs and reads its counter. The counter is 16 bits wide, so each
+ * read adds the signed difference since the last one to a 32-bit count.
+ * The position stays right as long as it is read, or service() is
+ * called, at least once every 32767 quarter-steps. readPosition(),
+ * resetPosition() and readVelocity() work as they do for Rotary.
+ *
+ * The sketch enables the timer's clock and connects the encoder's pin 1
+ * and pin 2 to the timer's channels 1 and 2, which depends on the core
+ * in use; see the QuadTimer example. extras/host/quad_timer_model.h
+ * models the registers for host builds.
+ */
+
+#ifndef rotary_quad_timer_h
+#define rotary_quad_timer_h
+
+#include "rotary.h"
+
+// The start of a timer's register block, in the STM32 order. Cast the
+// core's timer pointer, eg. (RotaryQuadTimerRegisters *)TIM2.
+struct RotaryQuadTimerRegisters {
+  volatile uint32_t CR1;
+  volatile uint32_t CR2;
+  volatile uint32_t SMCR;
+  volatile uint32_t DIER;
+  volatile uint32_t SR;
+  volatile uint32_t EGR;
+  volatile uint32_t CCMR1;
+  volatile uint32_t CCMR2;
+  volatile uint32_t CCER;
+  volatile uint32_t CNT;
+  volatile uint32_t PSC;
+  volatile uint32_t ARR;
+};
+
+// Register bits used.
+#define ROTARY_QT_CR1_CEN 0x0001
+#define ROTARY_QT_CR1_DIR 0x0010
+#define ROTARY_QT_SMCR_SMS 0x0007
+#define ROTARY_QT_SR_UIF 0x0001
+#define ROTARY_QT_EGR_UG 0x0001
+#define ROTARY_QT_CCMR1_CC1S 0x0003
+#define ROTARY_QT_CCMR1_IC1F 0x00f0
+#define ROTARY_QT_CCMR1_CC2S 0x0300
+#define ROTARY_QT_CCMR1_IC2F 0xf000
+#define ROTARY_QT_CCER_CC1P 0x0002
+#define ROTARY_QT_CCER_CC2P 0x0020
+// SMS: count the edges of both inputs, each direction from the other
+#define ROTARY_QT_ENCODER_MODE 3
+// CCxS: channel x captures input x
+#define ROTARY_QT_INPUT_DIRECT 1
+
+// Shortest time, in microseconds, over which readVelocity() measures.
+#define ROTARY_QT_VELOCITY_WINDOW 10000
+
+class RotaryQuadTimer
+{
+  public:
+    RotaryQuadTimer(RotaryQuadTimerRegisters *);
+    void setFilter(unsigned char);
+    void setReverse(bool);
+    void begin();
+    void end();
+    // From a periodic interrupt, if the position may go unread too long
+    void service();
+    long readPosition();
+    void resetPosition();
+    long readQuarters();
+    long readVelocity();
+  private:
+    void extend();
+    RotaryQuadTimerRegisters *timer;
+    unsigned char filter;
+    bool reverse;
+    // Counter value at the last read, and the 32-bit quarter-step count
+    uint16_t lastCounter;
+    volatile long quarters;
+    // Position last returned by readPosition(), in steps
+    long steps;
+    // Velocity in quarter-steps per second, measured over windows of at
+    // least ROTARY_QT_VELOCITY_WINDOW
+    unsigned long windowStart;
+    long windowQuarters;
+    volatile long velocity;
+};
+
+#endif
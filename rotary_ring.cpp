@@ -0,0 +1,116 @@
+/*
+ * Broadcast event ring.
+ *
+ * head counts every event ever pushed, and event n lives in slot
+ * n % ROTARY_RING_SIZE. The producer fills the slot before it advances
+ * head, so the slot it is about to write, the one at head, is never
+ * handed to a reader. A reader that is ROTARY_RING_SIZE - 1 events behind
+ * is reading the oldest slot still intact. After copying an event the
+ * reader looks at head again: if the producer has come round to that slot
+ * in the meantime, the copy may be torn, and the reader counts the event
+ * as lost instead. Nothing is ever locked, and the producer does the same
+ * work however many readers there are.
+ */
+
+#include "Arduino.h"
+#include "rotary_ring.h"
+
+#define ROTARY_RING_MASK (ROTARY_RING_SIZE - 1)
+
+RotaryEventRing::RotaryEventRing() {
+  head = 0;
+  memset((void *)slots, 0, sizeof(slots));
+}
+
+/*
+ * Adds an event for every reader. Call from one place only, eg. the
+ * interrupt handler that processes the encoders.
+ */
+void RotaryEventRing::push(const RotaryEvent &event) {
+  Slot &slot = slots[head & ROTARY_RING_MASK];
+  slot.time = event.time;
+  slot.source = event.source;
+  slot.event = event.event;
+  ROTARY_BARRIER();
+  head = head + 1;
+}
+
+/*
+ * Same as above, stamping the event with micros().
+ */
+void RotaryEventRing::push(unsigned char source, unsigned char event) {
+  RotaryEvent entry = {micros(), source, event};
+  push(entry);
+}
+
+/*
+ * Returns the number of events pushed since the ring was created.
+ */
+unsigned long RotaryEventRing::pushed() {
+  noInterrupts();
+  unsigned long result = head;
+  interrupts();
+  return result;
+}
+
+/*
+ * Starts a reader at the next event to be pushed. Readers can be created
+ * at any time; they only see events pushed after they were created.
+ */
+RotaryRingReader::RotaryRingReader(RotaryEventRing &source) : ring(source) {
+  next = ring.pushed();
+  overrun = 0;
+}
+
+/*
+ * Copies the reader's next event. Returns false if there is none yet.
+ * Events the reader fell too far behind to read are skipped and added to
+ * lost().
+ */
+bool RotaryRingReader::read(RotaryEvent &event) {
+  for (;;) {
+    unsigned long head = ring.pushed();
+    if (head == next) {
+      return false;
+    }
+    if (head - next >= ROTARY_RING_SIZE) {
+      overrun += head - next - (ROTARY_RING_SIZE - 1);
+      next = head - (ROTARY_RING_SIZE - 1);
+    }
+    ROTARY_BARRIER();
+    const RotaryEventRing::Slot &slot = ring.slots[next & ROTARY_RING_MASK];
+    event.time = slot.time;
+    event.source = slot.source;
+    event.event = slot.event;
+    ROTARY_BARRIER();
+    if (ring.pushed() - next < ROTARY_RING_SIZE) {
+      next++;
+      return true;
+    }
+    // Overwritten while copying; the loop counts it as lost
+  }
+}
+
+/*
+ * Returns the number of events waiting for this reader, at most
+ * ROTARY_RING_SIZE - 1 even if more were missed.
+ */
+unsigned long RotaryRingReader::available() {
+  unsigned long waiting = ring.pushed() - next;
+  return waiting < ROTARY_RING_SIZE ? waiting : ROTARY_RING_SIZE - 1;
+}
+
+/*
+ * Returns the number of events this reader missed by falling behind.
+ */
+unsigned long RotaryRingReader::lost() {
+  return overrun;
+}
+
+/*
+ * Drops every waiting event, eg. when a consumer that was paused only
+ * cares about what happens next. Skipped events do not count as lost.
+ */
+void RotaryRingReader::skip() {
+  next = ring.pushed();
+}
@@ -0,0 +1,56 @@
+/*
+ * Broadcast event ring: one producer, any number of consumers.
+ *
+ * The producer, usually an interrupt handler, writes each event once into
+ * a ring of ROTARY_RING_SIZE slots and never waits for anyone. Each
+ * consumer reads through its own RotaryRingReader, which keeps its own
+ * cursor, so a UI, a logger and a network reporter each see every event
+ * at their own pace. A consumer that falls more than the ring behind
+ * loses the oldest events; its reader skips them and counts them, without
+ * affecting the other readers.
+ */
+
+#ifndef rotary_ring_h
+#define rotary_ring_h
+
+#include "rotary.h"
+
+// Slots in the ring, a power of two. A reader can be at most one less
+// than this many events behind without losing any.
+#define ROTARY_RING_SIZE 32
+
+class RotaryEventRing
+{
+  friend class RotaryRingReader;
+  public:
+    RotaryEventRing();
+    // Producer side
+    void push(const RotaryEvent &);
+    void push(unsigned char, unsigned char);
+    // Number of events pushed since the start
+    unsigned long pushed();
+  private:
+    struct Slot {
+      volatile unsigned long time;
+      volatile unsigned char source;
+      volatile unsigned char event;
+    };
+    Slot slots[ROTARY_RING_SIZE];
+    volatile unsigned long head;
+};
+
+class RotaryRingReader
+{
+  public:
+    RotaryRingReader(RotaryEventRing &);
+    bool read(RotaryEvent &);
+    unsigned long available();
+    unsigned long lost();
+    void skip();
+  private:
+    RotaryEventRing &ring;
+    unsigned long next;
+    unsigned long overrun;
+};
+
+#endif
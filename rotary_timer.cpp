@@ -0,0 +1,197 @@
+/*
+ * Hierarchical timer wheel.
+ *
+ * Slot indexes come from the deadline itself: a timer at level L sits in
+ * slot (deadline >> L * ROTARY_WHEEL_BITS) % ROTARY_WHEEL_SLOTS. When the
+ * wheel's time reaches a multiple of a level's slot width, that level's
+ * slot for the new time is emptied and its timers are placed again, which
+ * moves them down to the level that now fits them. Level 0 slots then
+ * only ever hold timers due on that very tick.
+ */
+
+#include "rotary_timer.h"
+
+#define ROTARY_WHEEL_MASK (ROTARY_WHEEL_SLOTS - 1)
+
+RotaryTimer::RotaryTimer() {
+  next = 0;
+  prev = 0;
+  deadline = 0;
+  callback = 0;
+  context = 0;
+  home = 0;
+}
+
+RotaryTimer::RotaryTimer(RotaryTimerCallback function, void *argument) {
+  next = 0;
+  prev = 0;
+  deadline = 0;
+  callback = function;
+  context = argument;
+  home = 0;
+}
+
+/*
+ * Sets the function called, with the given argument, when the timer
+ * expires. Not while the timer is scheduled.
+ */
+void RotaryTimer::set(RotaryTimerCallback function, void *argument) {
+  callback = function;
+  context = argument;
+}
+
+/*
+ * Returns true from schedule() until the timer fires or is cancelled.
+ */
+bool RotaryTimer::scheduled() {
+  return home != 0;
+}
+
+/*
+ * Returns the tick the timer is, or was last, due on.
+ */
+unsigned long RotaryTimer::due() {
+  return deadline;
+}
+
+RotaryTimerWheel::RotaryTimerWheel() {
+  memset(slots, 0, sizeof(slots));
+  current = 0;
+  count = 0;
+}
+
+/*
+ * Sets the wheel's time, eg. to millis(). Call before scheduling.
+ */
+void RotaryTimerWheel::begin(unsigned long now) {
+  current = now;
+}
+
+/*
+ * Schedules the timer to fire the given number of ticks after the
+ * wheel's current time, at least 1. A timer that is already scheduled is
+ * moved to the new deadline.
+ */
+void RotaryTimerWheel::schedule(RotaryTimer &timer, unsigned long delay) {
+  if (timer.home) {
+    cancel(timer);
+  }
+  timer.deadline = current + (delay ? delay : 1);
+  place(timer);
+  count++;
+}
+
+/*
+ * Removes the timer from the wheel without calling it. Does nothing if it
+ * is not scheduled.
+ */
+void RotaryTimerWheel::cancel(RotaryTimer &timer) {
+  if (!timer.home) {
+    return;
+  }
+  if (timer.prev) {
+    timer.prev->next = timer.next;
+  }
+  else {
+    *timer.home = timer.next;
+  }
+  if (timer.next) {
+    timer.next->prev = timer.prev;
+  }
+  timer.home = 0;
+  count--;
+}
+
+void RotaryTimerWheel::place(RotaryTimer &timer) {
+  unsigned long ahead = timer.deadline - current;
+  RotaryTimer **list = 0;
+  for (unsigned char level = 0; level < ROTARY_WHEEL_LEVELS; level++) {
+    unsigned char shift = level * ROTARY_WHEEL_BITS;
+    // Slots between the current one at this level and the deadline's
+    unsigned long span = ((current & ((1UL << shift) - 1)) + ahead) >> shift;
+    if (span < ROTARY_WHEEL_SLOTS) {
+      list = &slots[level][(timer.deadline >> shift) & ROTARY_WHEEL_MASK];
+      break;
+    }
+  }
+  if (!list) {
+    // Too far ahead: wait in the top level's farthest slot
+    unsigned char shift = (ROTARY_WHEEL_LEVELS - 1) * ROTARY_WHEEL_BITS;
+    list = &slots[ROTARY_WHEEL_LEVELS - 1][((current >> shift) + ROTARY_WHEEL_MASK) & ROTARY_WHEEL_MASK];
+  }
+  timer.home = list;
+  timer.prev = 0;
+  timer.next = *list;
+  if (timer.next) {
+    timer.next->prev = &timer;
+  }
+  *list = &timer;
+}
+
+void RotaryTimerWheel::cascade(unsigned char level) {
+  RotaryTimer **list = &slots[level][(current >> (level * ROTARY_WHEEL_BITS)) & ROTARY_WHEEL_MASK];
+  RotaryTimer *timer = *list;
+  *list = 0;
+  while (timer) {
+    RotaryTimer *next = timer->next;
+    place(*timer);
+    timer = next;
+  }
+}
+
+/*
+ * Moves the wheel's time forward to now, one tick at a time, calling
+ * each timer that expires on the way. Callbacks may schedule and cancel
+ * timers. Returns the number of timers that fired. With nothing
+ * scheduled, the time simply jumps to now.
+ */
+unsigned int RotaryTimerWheel::advance(unsigned long now) {
+  unsigned int fired = 0;
+  while (current != now) {
+    if (!count) {
+      current = now;
+      break;
+    }
+    current++;
+    // Higher levels first, as their timers may land in lower levels'
+    // slots that are due now
+    unsigned char top = 0;
+    while (top + 1 < ROTARY_WHEEL_LEVELS &&
+           !(current & ((1UL << ((top + 1) * ROTARY_WHEEL_BITS)) - 1))) {
+      top++;
+    }
+    for (unsigned char level = top; level > 0; level--) {
+      cascade(level);
+    }
+    RotaryTimer **list = &slots[0][current & ROTARY_WHEEL_MASK];
+    while (RotaryTimer *timer = *list) {
+      cancel(*timer);
+      fired++;
+      if (timer->callback) {
+        timer->callback(timer->context);
+      }
+    }
+  }
+  return fired;
+}
+
+/*
+ * Same as above, up to millis().
+ */
+unsigned int RotaryTimerWheel::advance() {
+  return advance(millis());
+}
+
+/*
+ * Returns the wheel's current time.
+ */
+unsigned long RotaryTimerWheel::now() {
+  return current;
+}
+
+/*
+ * Returns the number of timers scheduled.
+ */
+unsigned int RotaryTimerWheel::pending() {
+  return count;
+}
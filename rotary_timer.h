@@ -0,0 +1,70 @@
+/*
+ * Hierarchical timer wheel for button deadlines.
+ *
+ * Debounce, long-press and double-click deadlines are scheduled on the
+ * wheel instead of being re-checked with millis() on every call for every
+ * button. Each tick only touches the timers that expire on it, plus, once
+ * every ROTARY_WHEEL_SLOTS ticks, the timers moving down a level, so the
+ * cost of a tick does not depend on how many buttons are waiting.
+ *
+ * Ticks are milliseconds. Level 0 has one slot per tick; each level above
+ * has slots ROTARY_WHEEL_SLOTS times as wide. Deadlines beyond the top
+ * level wait in its farthest slot and are placed again when they get
+ * there.
+ */
+
+#ifndef rotary_timer_h
+#define rotary_timer_h
+
+#include "Arduino.h"
+
+// Slots per level, a power of two, and the number of levels. With 16
+// slots and 3 levels, deadlines up to 4 s ahead are placed directly.
+#define ROTARY_WHEEL_BITS 4
+#define ROTARY_WHEEL_SLOTS (1 << ROTARY_WHEEL_BITS)
+#define ROTARY_WHEEL_LEVELS 3
+
+typedef void (*RotaryTimerCallback)(void *);
+
+// One deadline. The timer is linked into the wheel while it is scheduled,
+// so it must stay in place (eg. as a member of a button's state) until it
+// fires or is cancelled.
+class RotaryTimer
+{
+  friend class RotaryTimerWheel;
+  public:
+    RotaryTimer();
+    RotaryTimer(RotaryTimerCallback, void *);
+    void set(RotaryTimerCallback, void *);
+    bool scheduled();
+    unsigned long due();
+  private:
+    RotaryTimer *next;
+    RotaryTimer *prev;
+    unsigned long deadline;
+    RotaryTimerCallback callback;
+    void *context;
+    // List head of the slot the timer is in, or 0 when not scheduled
+    RotaryTimer **home;
+};
+
+class RotaryTimerWheel
+{
+  public:
+    RotaryTimerWheel();
+    void begin(unsigned long);
+    void schedule(RotaryTimer &, unsigned long);
+    void cancel(RotaryTimer &);
+    unsigned int advance(unsigned long);
+    unsigned int advance();
+    unsigned long now();
+    unsigned int pending();
+  private:
+    void place(RotaryTimer &);
+    void cascade(unsigned char);
+    RotaryTimer *slots[ROTARY_WHEEL_LEVELS][ROTARY_WHEEL_SLOTS];
+    unsigned long current;
+    unsigned int count;
+};
+
+#endif
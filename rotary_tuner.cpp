@@ -0,0 +1,108 @@
+/*
+ * Debounce auto-tuning for an encoder's button.
+ *
+ * The button is sampled through Rotary::readButton() on each call of
+ * buttonPressedReleased(), so the loop rate is the timing resolution.
+ */
+
+#include "Arduino.h"
+#include "rotary_tuner.h"
+
+RotaryDebounceTuner::RotaryDebounceTuner(Rotary &rotary) : encoder(rotary) {
+  // Fixed debounce until begin() has measured the button.
+  debounceDelay = ROTARY_DEBOUNCE_DEFAULT;
+  active = false;
+  bounceLevel = HIGH;
+  burstOpen = false;
+  burstStart = 0;
+  burstLast = 0;
+  bounceCount = 0;
+}
+
+/*
+ * Starts measuring the button's bounce. Every edge opens or extends a
+ * burst, and a burst ends after ROTARY_BURST_GAP microseconds without an
+ * edge. Once ROTARY_BOUNCE_SAMPLES bursts (presses and releases) have
+ * been timed, the debounce delay becomes the longest burst plus half
+ * again as margin, rounded up to whole milliseconds. Call again to
+ * remeasure, eg. once the switch has worn.
+ */
+void RotaryDebounceTuner::begin() {
+  active = true;
+  bounceCount = 0;
+  burstOpen = false;
+  bounceLevel = encoder.readButton() == encoder.BUTTON_RELEASED;
+}
+
+/*
+ * Same as the encoder's buttonPressedReleased(short), with the debounce
+ * delay measured by begin(), or ROTARY_DEBOUNCE_DEFAULT until tuning is
+ * done. While tuning, each call also samples the button to time its
+ * bounce, so call it as often as possible.
+ */
+bool RotaryDebounceTuner::buttonPressedReleased() {
+  if (active) {
+    sampleBounce();
+  }
+  return encoder.buttonPressedReleased(debounceDelay);
+}
+
+void RotaryDebounceTuner::sampleBounce() {
+  bool level = encoder.readButton() == encoder.BUTTON_RELEASED;
+  unsigned long now = micros();
+  if (level != bounceLevel) {
+    bounceLevel = level;
+    if (!burstOpen) {
+      burstOpen = true;
+      burstStart = now;
+    }
+    burstLast = now;
+  }
+  else if (burstOpen && now - burstLast > ROTARY_BURST_GAP) {
+    // The burst has settled, record how long it lasted
+    burstOpen = false;
+    bounceBursts[bounceCount++] = burstLast - burstStart;
+    if (bounceCount == ROTARY_BOUNCE_SAMPLES) {
+      unsigned long longest = 0;
+      for (unsigned char i = 0; i < bounceCount; i++) {
+        if (bounceBursts[i] > longest) {
+          longest = bounceBursts[i];
+        }
+      }
+      debounceDelay = (longest + longest / 2 + 999) / 1000;
+      if (debounceDelay < 1) {
+        debounceDelay = 1;
+      }
+      active = false;
+    }
+  }
+}
+
+/*
+ * True while bursts are still being measured.
+ */
+bool RotaryDebounceTuner::tuning() {
+  return active;
+}
+
+/*
+ * Debounce delay in milliseconds used by buttonPressedReleased().
+ */
+short RotaryDebounceTuner::debounce() {
+  return debounceDelay;
+}
+
+/*
+ * Number of bounce bursts measured so far, up to ROTARY_BOUNCE_SAMPLES.
+ */
+unsigned char RotaryDebounceTuner::samples() {
+  return bounceCount;
+}
+
+/*
+ * Duration in microseconds of a measured bounce burst, from its first
+ * edge to its last. A clean edge measures 0.
+ */
+unsigned long RotaryDebounceTuner::sample(unsigned char index) {
+  return index < bounceCount ? bounceBursts[index] : 0;
+}
@@ -0,0 +1,45 @@
+/*
+ * Debounce auto-tuning for an encoder's button.
+ *
+ * A RotaryDebounceTuner measures the bounce of one encoder's button and
+ * sets the debounce delay for buttonPressedReleased() from it. The state
+ * lives here rather than in Rotary, so only sketches that tune pay for it.
+ */
+
+#ifndef rotary_tuner_h
+#define rotary_tuner_h
+
+#include "rotary.h"
+
+// Button bounce measurement: number of bursts measured, and the quiet
+// time in microseconds that ends a burst.
+#define ROTARY_BOUNCE_SAMPLES 8
+#define ROTARY_BURST_GAP 20000
+// Debounce delay in milliseconds used until tuning completes.
+#define ROTARY_DEBOUNCE_DEFAULT 20
+
+class RotaryDebounceTuner
+{
+  public:
+    RotaryDebounceTuner(Rotary &);
+    void begin();
+    bool buttonPressedReleased();
+    bool tuning();
+    short debounce();
+    unsigned char samples();
+    unsigned long sample(unsigned char);
+  private:
+    void sampleBounce();
+    Rotary &encoder;
+    short debounceDelay;
+    bool active;
+    bool bounceLevel;
+    bool burstOpen;
+    unsigned long burstStart;
+    unsigned long burstLast;
+    unsigned char bounceCount;
+    // Microseconds, which a slow contact can take past 16 bits
+    unsigned long bounceBursts[ROTARY_BOUNCE_SAMPLES];
+};
+
+#endif
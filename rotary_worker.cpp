@@ -0,0 +1,171 @@
+/*
+ * Decoding worker for dual-core boards.
+ *
+ * The worker is the only writer of its slots. Each update is bracketed by
+ * two increments of the slot's sequence number, so a reader on the other
+ * core can tell a torn copy apart from a clean one and simply retry,
+ * without either side ever taking a lock or disabling interrupts.
+ *
+ * On ESP32 begin() starts the worker as a task pinned to one core. On
+ * other dual-core boards (eg. RP2040, which runs loop1() on the second
+ * core) call service() from the second core's loop. On a desktop host
+ * run() can be given its own thread.
+ */
+
+#include "Arduino.h"
+#include "rotary_worker.h"
+
+RotaryWorker::RotaryWorker() {
+  count = 0;
+  running = false;
+  passCount = 0;
+  memset((void *)slots, 0, sizeof(slots));
+}
+
+/*
+ * Adds an encoder to the worker. Returns its slot index for read(), or -1
+ * if all slots are taken or one of its pins is ROTARY_WORKER_LEVELS or
+ * above, which serviceLevels() could not decode. Must be called before
+ * the worker starts.
+ */
+signed char RotaryWorker::add(Rotary &encoder) {
+  return attach(encoder, false);
+}
+
+/*
+ * Same as add(), but the worker also publishes the encoder's button.
+ */
+signed char RotaryWorker::addWithButton(Rotary &encoder) {
+  return attach(encoder, true);
+}
+
+signed char RotaryWorker::attach(Rotary &encoder, bool button) {
+  if (count >= ROTARY_WORKER_SLOTS || encoder.pin1 >= ROTARY_WORKER_LEVELS ||
+      encoder.pin2 >= ROTARY_WORKER_LEVELS || (button && encoder.buttonPin >= ROTARY_WORKER_LEVELS)) {
+    return -1;
+  }
+  encoders[count] = &encoder;
+  buttons[count] = button;
+  slots[count].position = encoder.readPosition();
+  slots[count].button = button ? encoder.readButton() : 0;
+  return count++;
+}
+
+/*
+ * One pass over all encoders. A slot is only rewritten when its encoder
+ * produced a step or its button changed.
+ */
+void RotaryWorker::service() {
+  for (unsigned char i = 0; i < count; i++) {
+    unsigned char result = encoders[i]->process();
+    unsigned char button = buttons[i] ? encoders[i]->readButton() : 0;
+    publish(i, result, button);
+  }
+  passCount++;
+}
+
+/*
+ * Same as service(), but decodes pin levels that were all sampled at
+ * once, eg. from one read of a GPIO port, instead of reading each pin.
+ * Bit n of levels is the level of pin n. The word is 64 bits so that pins
+ * past 31, such as GPIO 32 to 39 on ESP32, can be decoded too.
+ */
+void RotaryWorker::serviceLevels(uint64_t levels) {
+  for (unsigned char i = 0; i < count; i++) {
+    Rotary &encoder = *encoders[i];
+    unsigned char pinstate = ((levels >> encoder.pin2) & 1) << 1 | ((levels >> encoder.pin1) & 1);
+    unsigned char result = encoder.process(pinstate);
+    unsigned char button = 0;
+    if (buttons[i]) {
+      button = (levels >> encoder.buttonPin) & 1 ? encoder.BUTTON_RELEASED : encoder.BUTTON_PRESSED;
+    }
+    publish(i, result, button);
+  }
+  passCount++;
+}
+
+void RotaryWorker::publish(unsigned char index, unsigned char result, unsigned char button) {
+  RotaryWorkerSlot &slot = slots[index];
+  if (result || button != slot.button) {
+    slot.sequence++;
+    ROTARY_BARRIER();
+    // The worker is the encoder's only decoder, so its position can be
+    // read directly; readPosition() would disable interrupts
+    slot.position = encoders[index]->position;
+    if (result) {
+      slot.events++;
+      slot.direction = result;
+    }
+    slot.button = button;
+    ROTARY_BARRIER();
+    slot.sequence++;
+  }
+}
+
+/*
+ * Services the encoders continuously until stop() is called.
+ */
+void RotaryWorker::run() {
+  running = true;
+  while (running) {
+    service();
+  }
+}
+
+/*
+ * Asks run() to return after its current pass. Safe to call from the
+ * other core.
+ */
+void RotaryWorker::stop() {
+  running = false;
+}
+
+#if defined(ESP32)
+static void rotaryWorkerTask(void *worker) {
+  ((RotaryWorker *)worker)->run();
+  vTaskDelete(NULL);
+}
+
+/*
+ * Starts the worker as a task pinned to the given core. The task runs at
+ * idle priority so that the core's idle task still gets its time slice
+ * and the task watchdog stays fed.
+ */
+bool RotaryWorker::begin(int core) {
+  return xTaskCreatePinnedToCore(rotaryWorkerTask, "rotary", 2048, this,
+                                 tskIDLE_PRIORITY, NULL, core) == pdPASS;
+}
+#endif
+
+/*
+ * Copies the latest results for one slot. Retries while the worker is
+ * updating the slot, so the copy is always from a single update.
+ * Returns false for an unused slot index.
+ */
+bool RotaryWorker::read(unsigned char index, RotaryWorkerReading &reading) {
+  if (index >= count) {
+    return false;
+  }
+  const RotaryWorkerSlot &slot = slots[index];
+  unsigned long before;
+  unsigned long after;
+  do {
+    before = slot.sequence;
+    ROTARY_BARRIER();
+    reading.position = slot.position;
+    reading.events = slot.events;
+    reading.direction = slot.direction;
+    reading.button = slot.button;
+    ROTARY_BARRIER();
+    after = slot.sequence;
+  } while (before != after || (before & 1));
+  return true;
+}
+
+/*
+ * Number of passes the worker has made over its encoders. Sampling rate
+ * per encoder is the rate at which this grows.
+ */
+unsigned long RotaryWorker::passes() {
+  return passCount;
+}
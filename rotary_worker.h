@@ -0,0 +1,76 @@
+/*
+ * Decoding worker for dual-core boards.
+ *
+ * One core runs the worker loop, which samples and decodes every encoder
+ * added to it. The other core reads the results through read(). Each
+ * encoder's results live in their own slot, written only by the worker
+ * and padded to a cache line so that two slots never share one.
+ */
+
+#ifndef rotary_worker_h
+#define rotary_worker_h
+
+#include "rotary.h"
+
+// Number of encoders one worker can service.
+#define ROTARY_WORKER_SLOTS 8
+// Bits in the level word of serviceLevels(), ie. pins it can decode.
+#define ROTARY_WORKER_LEVELS 64
+
+// Slot alignment. No padding is needed on single-core AVR.
+#if defined(__AVR__)
+#define ROTARY_CACHE_LINE 1
+#elif defined(__x86_64__) || defined(__aarch64__)
+#define ROTARY_CACHE_LINE 64
+#else
+#define ROTARY_CACHE_LINE 32
+#endif
+
+// Copy of one encoder's published results.
+struct RotaryWorkerReading {
+  long position;
+  unsigned long events;
+  unsigned char direction;
+  unsigned char button;
+};
+
+// Published results for one encoder. The sequence number is odd while
+// the worker is part way through an update.
+struct RotaryWorkerSlot {
+  volatile unsigned long sequence;
+  volatile long position;
+  volatile unsigned long events;
+  volatile unsigned char direction;
+  volatile unsigned char button;
+} __attribute__((aligned(ROTARY_CACHE_LINE)));
+
+class RotaryWorker
+{
+  public:
+    RotaryWorker();
+    // Register encoders before the worker starts
+    signed char add(Rotary &);
+    signed char addWithButton(Rotary &);
+    // Worker side
+    void service();
+    void serviceLevels(uint64_t);
+    void run();
+    void stop();
+#if defined(ESP32)
+    bool begin(int);
+#endif
+    // Reader side
+    bool read(unsigned char, RotaryWorkerReading &);
+    unsigned long passes();
+  private:
+    signed char attach(Rotary &, bool);
+    void publish(unsigned char, unsigned char, unsigned char);
+    RotaryWorkerSlot slots[ROTARY_WORKER_SLOTS];
+    Rotary *encoders[ROTARY_WORKER_SLOTS];
+    bool buttons[ROTARY_WORKER_SLOTS];
+    unsigned char count;
+    volatile bool running;
+    volatile unsigned long passCount __attribute__((aligned(ROTARY_CACHE_LINE)));
+};
+
+#endif